@@ -934,6 +934,16 @@ void ARMJIT::CompileBlock(ARM* cpu) noexcept
     u64* entry = &FastBlockLookupRegions[(localAddr >> 27)][(localAddr & 0x7FFFFFF) / 2];
     *entry = ((u64)blockAddr | cpu->Num) << 32;
     *entry |= JITCompiler.SubEntryOffset(block->EntryPoint);
+
+    // the block was interpreted before it was registered, so
+    // writes into its own code didn't invalidate it yet
+    for (u32 j = 0; j < numWriteAddrs; j++)
+    {
+        u32 translatedAddr = LocaliseCodeAddress(cpu->Num, writeAddrs[j]);
+        if (translatedAddr
+            && CodeMemRegions[translatedAddr >> 27][(translatedAddr & 0x7FFFFFF) / 512].Code & (1 << ((translatedAddr & 0x1FF) / 16)))
+            InvalidateByAddr(translatedAddr);
+    }
 }
 
 void ARMJIT::InvalidateByAddr(u32 localAddr) noexcept
@@ -1158,6 +1168,98 @@ void ARMJIT::ResetBlockCache() noexcept
     JITCompiler.Reset();
 }
 
+void ARMJIT::ReadCodeChunk(u32 localAddr, u8* dst) const noexcept
+{
+    u32 offset = localAddr & 0x7FFFFFF;
+    const u8* src;
+    switch (localAddr >> 27)
+    {
+    case ARMJIT_Memory::memregion_ITCM: src = &NDS.ARM9.ITCM[offset]; break;
+    case ARMJIT_Memory::memregion_MainRAM: src = &Memory.GetMainRAM()[offset]; break;
+    case ARMJIT_Memory::memregion_SharedWRAM: src = &Memory.GetSharedWRAM()[offset]; break;
+    case ARMJIT_Memory::memregion_WRAM7: src = &Memory.GetARM7WRAM()[offset]; break;
+    case ARMJIT_Memory::memregion_NewSharedWRAM_A: src = &Memory.GetNWRAM_A()[offset]; break;
+    case ARMJIT_Memory::memregion_NewSharedWRAM_B: src = &Memory.GetNWRAM_B()[offset]; break;
+    case ARMJIT_Memory::memregion_NewSharedWRAM_C: src = &Memory.GetNWRAM_C()[offset]; break;
+    case ARMJIT_Memory::memregion_VRAM:
+    case ARMJIT_Memory::memregion_VWRAM:
+        // VRAM goes through the current bank mapping
+        for (u32 i = 0; i < 16; i += 4)
+        {
+            u32 val = (localAddr >> 27) == ARMJIT_Memory::memregion_VRAM
+                ? NDS.GPU.ReadVRAM_LCDC<u32>(0x06800000 + offset + i)
+                : NDS.GPU.ReadVRAM_ARM7<u32>(0x06000000 + offset + i);
+            memcpy(&dst[i], &val, 4);
+        }
+        return;
+    default:
+        // BIOSes can't change
+        memset(dst, 0, 16);
+        return;
+    }
+
+    memcpy(dst, src, 16);
+}
+
+void ARMJIT::SnapshotCode() noexcept
+{
+    static constexpr int regions[] =
+    {
+        ARMJIT_Memory::memregion_ITCM,
+        ARMJIT_Memory::memregion_MainRAM,
+        ARMJIT_Memory::memregion_SharedWRAM,
+        ARMJIT_Memory::memregion_VRAM,
+        ARMJIT_Memory::memregion_WRAM7,
+        ARMJIT_Memory::memregion_VWRAM,
+        ARMJIT_Memory::memregion_NewSharedWRAM_A,
+        ARMJIT_Memory::memregion_NewSharedWRAM_B,
+        ARMJIT_Memory::memregion_NewSharedWRAM_C,
+    };
+
+    CodeSnapshot.clear();
+    for (int region : regions)
+    {
+        const AddressRange* ranges = CodeMemRegions[region];
+        for (u32 i = 0; i < CodeRegionSizes[region] / 512; i++)
+        {
+            // one bit per 16 bytes with code in them
+            u32 code = ranges[i].Code;
+            while (code)
+            {
+                u32 chunk = __builtin_ctz(code);
+                code &= code - 1;
+
+                CodeChunk& entry = CodeSnapshot.emplace_back();
+                entry.Addr = (region << 27) | (i * 512) | (chunk * 16);
+                ReadCodeChunk(entry.Addr, entry.Data);
+            }
+        }
+    }
+}
+
+void ARMJIT::InvalidateChangedCode() noexcept
+{
+    JitEnableWrite();
+
+    // the memory mappings might not match anymore,
+    // they're set up again as they're needed
+    Memory.Reset();
+
+    for (const CodeChunk& entry : CodeSnapshot)
+    {
+        u8 data[16];
+        ReadCodeChunk(entry.Addr, data);
+        if (memcmp(data, entry.Data, 16) == 0)
+            continue;
+
+        // might have gone already with a block invalidated before
+        if (CodeMemRegions[entry.Addr >> 27][(entry.Addr & 0x7FFFFFF) / 512].Code & (1 << ((entry.Addr & 0x1FF) / 16)))
+            InvalidateByAddr(entry.Addr);
+    }
+
+    CodeSnapshot.clear();
+}
+
 void ARMJIT::JitEnableWrite() noexcept
 {
     #if defined(__APPLE__) && defined(__aarch64__)
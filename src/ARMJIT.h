@@ -22,6 +22,7 @@
 #include <algorithm>
 #include <optional>
 #include <memory>
+#include <vector>
 #include "types.h"
 #include "MemConstants.h"
 #include "Args.h"
@@ -63,6 +64,13 @@ public:
     void CompileBlock(ARM* cpu) noexcept;
     void ResetBlockCache() noexcept;
 
+    /// Records the memory contents all compiled blocks were compiled from.
+    void SnapshotCode() noexcept;
+
+    /// Invalidates the blocks whose memory differs from the last SnapshotCode(),
+    /// for when memory was overwritten wholesale (e.g. by loading a savestate).
+    void InvalidateChangedCode() noexcept;
+
     template <u32 num, int region>
     void CheckAndInvalidate(u32 addr) noexcept
     {
@@ -86,6 +94,7 @@ public:
     friend class ARMJIT_Memory;
     void blockSanityCheck(u32 num, u32 blockAddr, JitBlockEntry entry) noexcept;
     void RetireJitBlock(JitBlock* block) noexcept;
+    void ReadCodeChunk(u32 localAddr, u8* dst) const noexcept;
 
     int GetMaxBlockSize() const noexcept { return MaxBlockSize; }
     bool LiteralOptimizationsEnabled() const noexcept { return LiteralOptimizations; }
@@ -104,6 +113,13 @@ public:
 
     std::unordered_map<u32, JitBlock*> RestoreCandidates {};
 
+    struct CodeChunk
+    {
+        u32 Addr;
+        u8 Data[16];
+    };
+    std::vector<CodeChunk> CodeSnapshot {};
+
 
     AddressRange CodeIndexITCM[ITCMPhysicalSize / 512] {};
     AddressRange CodeIndexMainRAM[MainRAMMaxSize / 512] {};
@@ -201,6 +217,8 @@ public:
     void JitEnableExecute() noexcept {}
     void CompileBlock(ARM*) noexcept {}
     void ResetBlockCache() noexcept {}
+    void SnapshotCode() noexcept {}
+    void InvalidateChangedCode() noexcept {}
     template <u32, int>
     void CheckAndInvalidate(u32 addr) noexcept {}
 
@@ -576,6 +576,55 @@ void DMA::Run9()
             if (NDS.ARM9Timestamp >= NDS.ARM9Target) break;
         }
     }
+    else if (IsGXFIFODMA)
+    {
+        // geometry command DMA: fetch a run of words, then hand them all
+        // to the geometry engine in one go
+        while (IterCount > 0 && !Stall)
+        {
+            u32 vals[GXFIFOBurstLength];
+            u64 timestamp = NDS.ARM9Timestamp;
+            u32 srcaddr = CurSrcAddr;
+            u32 burstcount = MRAMBurstCount;
+            bool wasburststart = burststart;
+
+            u32 num = 0;
+            while (num < IterCount && num < GXFIFOBurstLength)
+            {
+                NDS.ARM9Timestamp += (UnitTimings9_32(burststart) << NDS.ARM9ClockShift);
+                burststart = false;
+
+                vals[num++] = NDS.ARM9Read32(CurSrcAddr);
+                CurSrcAddr += SrcAddrInc<<2;
+
+                if (NDS.ARM9Timestamp >= NDS.ARM9Target) break;
+            }
+
+            u32 done = NDS.GPU.GPU3D.WriteToGXFIFO(vals, num);
+            if (done < num)
+            {
+                // the FIFO stalled partway through the run
+                // only account for the words it took
+                NDS.ARM9Timestamp = timestamp;
+                CurSrcAddr = srcaddr;
+                MRAMBurstCount = burstcount;
+                burststart = wasburststart;
+
+                for (u32 i = 0; i < done; i++)
+                {
+                    NDS.ARM9Timestamp += (UnitTimings9_32(burststart) << NDS.ARM9ClockShift);
+                    burststart = false;
+
+                    CurSrcAddr += SrcAddrInc<<2;
+                }
+            }
+
+            IterCount -= done;
+            RemCount -= done;
+
+            if (NDS.ARM9Timestamp >= NDS.ARM9Target) break;
+        }
+    }
     else
     {
         while (IterCount > 0 && !Stall)
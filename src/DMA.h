@@ -78,6 +78,8 @@ public:
     u32 Cnt {};
 
 private:
+    static constexpr u32 GXFIFOBurstLength = 64;
+
     melonDS::NDS& NDS;
     u32 CPU {};
     u32 Num {};
@@ -579,9 +579,11 @@ void DSi::SetupDirectBoot()
         }
     }
 
+    // read through the cart so any DLDI patch applied to the binary is included
     for (u32 i = arm9start; i < header.ARM9Size; i+=4)
     {
-        u32 tmp = *(u32*)&cartrom[header.ARM9ROMOffset+i];
+        u32 tmp = 0;
+        NDSCartSlot.GetCart()->ReadROM(header.ARM9ROMOffset+i, 4, (u8*)&tmp, 0);
         ARM9Write32(header.ARM9RAMAddress+i, tmp);
     }
 
@@ -98,7 +98,7 @@ FATStorage::~FATStorage()
     File = nullptr;
 }
 
-bool FATStorage::InjectFile(const std::string& path, u8* data, u32 len)
+bool FATStorage::InjectFile(const std::string& path, const u8* data, u32 len)
 {
     if (!File) return false;
 
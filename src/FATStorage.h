@@ -59,7 +59,7 @@ public:
     FATStorage& operator=(FATStorage&& other) noexcept;
     ~FATStorage();
 
-    bool InjectFile(const std::string& path, u8* data, u32 len);
+    bool InjectFile(const std::string& path, const u8* data, u32 len);
     u32 ReadFile(const std::string& path, u32 start, u32 len, u8* data);
 
     u32 ReadSectors(u32 start, u32 num, u8* data) const;
@@ -172,23 +172,20 @@ void GPU::Reset() noexcept
     else
         fbsize = 256 * 192;
 
-    for (size_t i = 0; i < fbsize; i++)
+    for (auto& fb : Framebuffer)
     {
-        Framebuffer[0][0][i] = 0xFFFFFFFF;
-        Framebuffer[1][0][i] = 0xFFFFFFFF;
-    }
-    for (size_t i = 0; i < fbsize; i++)
-    {
-        Framebuffer[0][1][i] = 0xFFFFFFFF;
-        Framebuffer[1][1][i] = 0xFFFFFFFF;
+        for (size_t i = 0; i < fbsize; i++)
+        {
+            fb[0][i] = 0xFFFFFFFF;
+            fb[1][i] = 0xFFFFFFFF;
+        }
     }
 
     GPU2D_A.Reset();
     GPU2D_B.Reset();
     GPU3D.Reset();
 
-    int backbuf = FrontBuffer ? 0 : 1;
-    GPU2D_Renderer->SetFramebuffer(Framebuffer[backbuf][1].get(), Framebuffer[backbuf][0].get());
+    GPU2D_Renderer->SetFramebuffer(Framebuffer[BackBuffer][1].get(), Framebuffer[BackBuffer][0].get());
 
     ResetVRAMCache();
 
@@ -204,10 +201,11 @@ void GPU::Stop() noexcept
     else
         fbsize = 256 * 192;
 
-    memset(Framebuffer[0][0].get(), 0, fbsize*4);
-    memset(Framebuffer[0][1].get(), 0, fbsize*4);
-    memset(Framebuffer[1][0].get(), 0, fbsize*4);
-    memset(Framebuffer[1][1].get(), 0, fbsize*4);
+    for (auto& fb : Framebuffer)
+    {
+        memset(fb[0].get(), 0, fbsize*4);
+        memset(fb[1].get(), 0, fbsize*4);
+    }
 
     GPU3D.Stop(*this);
 }
@@ -276,22 +274,60 @@ void GPU::DoSavestate(Savestate* file) noexcept
     GPU3D.DoSavestate(file);
 
     if (!file->Saving)
+    {
         ResetVRAMCache();
+        OAMDirty = 0x3;
+        PaletteDirty = 0xF;
+    }
+}
+
+void GPU::UpdateDirtyGenerations() noexcept
+{
+    // palette bits are per 512 bytes: engine A BG/OBJ, then engine B BG/OBJ
+    if (PaletteDirty & 0x3) PaletteGeneration[0]++;
+    if (PaletteDirty & 0xC) PaletteGeneration[1]++;
+    if (OAMDirty & 0x1) OAMGeneration[0]++;
+    if (OAMDirty & 0x2) OAMGeneration[1]++;
+
+    PaletteDirty = 0;
+    OAMDirty = 0;
 }
 
 void GPU::AssignFramebuffers() noexcept
 {
-    int backbuf = FrontBuffer ? 0 : 1;
     if (NDS.PowerControl9 & (1<<15))
     {
-        GPU2D_Renderer->SetFramebuffer(Framebuffer[backbuf][0].get(), Framebuffer[backbuf][1].get());
+        GPU2D_Renderer->SetFramebuffer(Framebuffer[BackBuffer][0].get(), Framebuffer[BackBuffer][1].get());
     }
     else
     {
-        GPU2D_Renderer->SetFramebuffer(Framebuffer[backbuf][1].get(), Framebuffer[backbuf][0].get());
+        GPU2D_Renderer->SetFramebuffer(Framebuffer[BackBuffer][1].get(), Framebuffer[BackBuffer][0].get());
     }
 }
 
+void GPU::PublishFrame() noexcept
+{
+    // swap the finished frame with the one in the shared slot
+    // if the presenter never took that one, it gets dropped
+    u32 old = PresentSlot.exchange(BackBuffer | PresentSlotFresh, std::memory_order_acq_rel);
+    if (old & PresentSlotFresh)
+        DroppedFrames.fetch_add(1, std::memory_order_relaxed);
+
+    BackBuffer = old & 0x3;
+    AssignFramebuffers();
+}
+
+int GPU::AcquireFrontBuffer() noexcept
+{
+    // only the presenter clears the fresh flag, so it can't go away between those two
+    if (PresentSlot.load(std::memory_order_acquire) & PresentSlotFresh)
+        PresentBuffer = PresentSlot.exchange(PresentBuffer, std::memory_order_acq_rel) & 0x3;
+    else
+        DuplicatedFrames.fetch_add(1, std::memory_order_relaxed);
+
+    return PresentBuffer;
+}
+
 void GPU::SetRenderer3D(std::unique_ptr<Renderer3D>&& renderer) noexcept
 {
     if (renderer == nullptr)
@@ -310,15 +346,14 @@ void GPU::InitFramebuffers() noexcept
     else
         fbsize = 256 * 192;
 
-    Framebuffer[0][0] = std::make_unique<u32[]>(fbsize);
-    Framebuffer[1][0] = std::make_unique<u32[]>(fbsize);
-    Framebuffer[0][1] = std::make_unique<u32[]>(fbsize);
-    Framebuffer[1][1] = std::make_unique<u32[]>(fbsize);
+    for (auto& fb : Framebuffer)
+    {
+        fb[0] = std::make_unique<u32[]>(fbsize);
+        fb[1] = std::make_unique<u32[]>(fbsize);
 
-    memset(Framebuffer[0][0].get(), 0, fbsize*4);
-    memset(Framebuffer[1][0].get(), 0, fbsize*4);
-    memset(Framebuffer[0][1].get(), 0, fbsize*4);
-    memset(Framebuffer[1][1].get(), 0, fbsize*4);
+        memset(fb[0].get(), 0, fbsize*4);
+        memset(fb[1].get(), 0, fbsize*4);
+    }
 
     AssignFramebuffers();
 }
@@ -881,19 +916,37 @@ void GPU::StartHBlank(u32 line) noexcept
 
     if (VCount < 192)
     {
-        // draw
-        // note: this should start 48 cycles after the scanline start
-        if (line < 192)
+        // rendering can only be skipped if nothing gets captured back into VRAM
+        bool skiprender = SuppressRendering && !GPU2D_A.CaptureLatch && !(GPU2D_A.CaptureCnt & (1<<31));
+
+        if (skiprender)
         {
-            GPU2D_Renderer->DrawScanline(line, &GPU2D_A);
-            GPU2D_Renderer->DrawScanline(line, &GPU2D_B);
+            // the 3D renderer still hands out every scanline
+            // so that a threaded renderer stays in sync with us
+            if (line < 192 && !GPU3D.IsRendererAccelerated())
+                GPU3D.GetLine(line);
         }
-
-        // sprites are pre-rendered one scanline in advance
-        if (line < 191)
+        else
         {
-            GPU2D_Renderer->DrawSprites(line+1, &GPU2D_A);
-            GPU2D_Renderer->DrawSprites(line+1, &GPU2D_B);
+            UpdateDirtyGenerations();
+
+            // draw
+            // note: this should start 48 cycles after the scanline start
+            // engine B goes first, so a threaded renderer can draw it while drawing engine A
+            if (line < 192)
+            {
+                GPU2D_Renderer->DrawScanline(line, &GPU2D_B);
+                GPU2D_Renderer->DrawScanline(line, &GPU2D_A);
+            }
+
+            // sprites are pre-rendered one scanline in advance
+            if (line < 191)
+            {
+                GPU2D_Renderer->DrawSprites(line+1, &GPU2D_B);
+                GPU2D_Renderer->DrawSprites(line+1, &GPU2D_A);
+            }
+
+            GPU2D_Renderer->Sync();
         }
 
         NDS.CheckDMAs(0, 0x02);
@@ -904,8 +957,12 @@ void GPU::StartHBlank(u32 line) noexcept
     }
     else if (VCount == 262)
     {
-        GPU2D_Renderer->DrawSprites(0, &GPU2D_A);
+        // always done, even when rendering is suppressed:
+        // the next frame might not be
+        UpdateDirtyGenerations();
         GPU2D_Renderer->DrawSprites(0, &GPU2D_B);
+        GPU2D_Renderer->DrawSprites(0, &GPU2D_A);
+        GPU2D_Renderer->Sync();
     }
 
     if (DispStat[0] & (1<<4)) NDS.SetIRQ(0, IRQ_HBlank);
@@ -919,8 +976,9 @@ void GPU::StartHBlank(u32 line) noexcept
 
 void GPU::FinishFrame(u32 lines) noexcept
 {
-    FrontBuffer = FrontBuffer ? 0 : 1;
-    AssignFramebuffers();
+    // a suppressed frame was only partly drawn, the presenter keeps the last real one
+    if (!SuppressRendering)
+        PublishFrame();
 
     TotalScanlines = lines;
 
@@ -933,22 +991,33 @@ void GPU::FinishFrame(u32 lines) noexcept
 
 void GPU::BlankFrame() noexcept
 {
-    int backbuf = FrontBuffer ? 0 : 1;
     int fbsize;
     if (GPU3D.IsRendererAccelerated())
         fbsize = (256*3 + 1) * 192;
     else
         fbsize = 256 * 192;
 
-    memset(Framebuffer[backbuf][0].get(), 0, fbsize*4);
-    memset(Framebuffer[backbuf][1].get(), 0, fbsize*4);
+    if (!SuppressRendering)
+    {
+        memset(Framebuffer[BackBuffer][0].get(), 0, fbsize*4);
+        memset(Framebuffer[BackBuffer][1].get(), 0, fbsize*4);
 
-    FrontBuffer = backbuf;
-    AssignFramebuffers();
+        PublishFrame();
+    }
 
     TotalScanlines = 263;
 }
 
+void GPU::RedoVBlankRendering() noexcept
+{
+    GPU3D.RerenderFrame(*this);
+
+    UpdateDirtyGenerations();
+    GPU2D_Renderer->DrawSprites(0, &GPU2D_B);
+    GPU2D_Renderer->DrawSprites(0, &GPU2D_A);
+    GPU2D_Renderer->Sync();
+}
+
 void GPU::StartScanline(u32 line) noexcept
 {
     if (line == 0)
@@ -1072,6 +1141,29 @@ template <u32 Size, u32 MappingGranularity>
 NonStupidBitField<Size/VRAMDirtyGranularity> VRAMTrackingSet<Size, MappingGranularity>::DeriveState(const u32* currentMappings, GPU& gpu)
 {
     NonStupidBitField<Size/VRAMDirtyGranularity> result;
+
+    // fast exit for the common case: same mappings and none of their banks written to
+    u32 mappedBanks = 0;
+    bool remapped = false;
+    for (u32 i = 0; i < Size / MappingGranularity; i++)
+    {
+        mappedBanks |= currentMappings[i];
+        remapped |= currentMappings[i] != Mapping[i];
+    }
+    if (!remapped)
+    {
+        u64 written = 0;
+        for (u32 banks = mappedBanks; banks != 0; banks &= banks - 1)
+        {
+            const auto& bankDirty = gpu.VRAMDirty[__builtin_ctz(banks)];
+            for (u32 j = 0; j < bankDirty.DataLength; j++)
+                written |= bankDirty.Data[j];
+        }
+
+        if (!written)
+            return result;
+    }
+
     u16 banksToBeZeroed = 0;
     for (u32 i = 0; i < Size / MappingGranularity; i++)
     {
@@ -1143,46 +1235,46 @@ template NonStupidBitField<512*1024/VRAMDirtyGranularity> VRAMTrackingSet<512*10
 
 bool GPU::MakeVRAMFlat_TextureCoherent(NonStupidBitField<512*1024/VRAMDirtyGranularity>& dirty) noexcept
 {
-    return CopyLinearVRAM<128*1024>(VRAMFlat_Texture, VRAMMap_Texture, dirty, &GPU::ReadVRAM_Texture<u64>);
+    return CopyLinearVRAM<128*1024>(VRAMFlat_Texture, VRAMMap_Texture, dirty);
 }
 bool GPU::MakeVRAMFlat_TexPalCoherent(NonStupidBitField<128*1024/VRAMDirtyGranularity>& dirty) noexcept
 {
-    return CopyLinearVRAM<16*1024>(VRAMFlat_TexPal, VRAMMap_TexPal, dirty, &GPU::ReadVRAM_TexPal<u64>);
+    return CopyLinearVRAM<16*1024>(VRAMFlat_TexPal, VRAMMap_TexPal, dirty);
 }
 
 bool GPU::MakeVRAMFlat_ABGCoherent(NonStupidBitField<512*1024/VRAMDirtyGranularity>& dirty) noexcept
 {
-    return CopyLinearVRAM<16*1024>(VRAMFlat_ABG, VRAMMap_ABG, dirty, &GPU::ReadVRAM_ABG<u64>);
+    return CopyLinearVRAM<16*1024>(VRAMFlat_ABG, VRAMMap_ABG, dirty);
 }
 bool GPU::MakeVRAMFlat_BBGCoherent(NonStupidBitField<128*1024/VRAMDirtyGranularity>& dirty) noexcept
 {
-    return CopyLinearVRAM<16*1024>(VRAMFlat_BBG, VRAMMap_BBG, dirty, &GPU::ReadVRAM_BBG<u64>);
+    return CopyLinearVRAM<16*1024>(VRAMFlat_BBG, VRAMMap_BBG, dirty);
 }
 
 bool GPU::MakeVRAMFlat_AOBJCoherent(NonStupidBitField<256*1024/VRAMDirtyGranularity>& dirty) noexcept
 {
-    return CopyLinearVRAM<16*1024>(VRAMFlat_AOBJ, VRAMMap_AOBJ, dirty, &GPU::ReadVRAM_AOBJ<u64>);
+    return CopyLinearVRAM<16*1024>(VRAMFlat_AOBJ, VRAMMap_AOBJ, dirty);
 }
 bool GPU::MakeVRAMFlat_BOBJCoherent(NonStupidBitField<128*1024/VRAMDirtyGranularity>& dirty) noexcept
 {
-    return CopyLinearVRAM<16*1024>(VRAMFlat_BOBJ, VRAMMap_BOBJ, dirty, &GPU::ReadVRAM_BOBJ<u64>);
+    return CopyLinearVRAM<16*1024>(VRAMFlat_BOBJ, VRAMMap_BOBJ, dirty);
 }
 
 bool GPU::MakeVRAMFlat_ABGExtPalCoherent(NonStupidBitField<32*1024/VRAMDirtyGranularity>& dirty) noexcept
 {
-    return CopyLinearVRAM<8*1024>(VRAMFlat_ABGExtPal, VRAMMap_ABGExtPal, dirty, &GPU::ReadVRAM_ABGExtPal<u64>);
+    return CopyLinearVRAM<8*1024>(VRAMFlat_ABGExtPal, VRAMMap_ABGExtPal, dirty);
 }
 bool GPU::MakeVRAMFlat_BBGExtPalCoherent(NonStupidBitField<32*1024/VRAMDirtyGranularity>& dirty) noexcept
 {
-    return CopyLinearVRAM<8*1024>(VRAMFlat_BBGExtPal, VRAMMap_BBGExtPal, dirty, &GPU::ReadVRAM_BBGExtPal<u64>);
+    return CopyLinearVRAM<8*1024>(VRAMFlat_BBGExtPal, VRAMMap_BBGExtPal, dirty);
 }
 
 bool GPU::MakeVRAMFlat_AOBJExtPalCoherent(NonStupidBitField<8*1024/VRAMDirtyGranularity>& dirty) noexcept
 {
-    return CopyLinearVRAM<8*1024>(VRAMFlat_AOBJExtPal, &VRAMMap_AOBJExtPal, dirty, &GPU::ReadVRAM_AOBJExtPal<u64>);
+    return CopyLinearVRAM<8*1024>(VRAMFlat_AOBJExtPal, &VRAMMap_AOBJExtPal, dirty);
 }
 bool GPU::MakeVRAMFlat_BOBJExtPalCoherent(NonStupidBitField<8*1024/VRAMDirtyGranularity>& dirty) noexcept
 {
-    return CopyLinearVRAM<8*1024>(VRAMFlat_BOBJExtPal, &VRAMMap_BOBJExtPal, dirty, &GPU::ReadVRAM_BOBJExtPal<u64>);
+    return CopyLinearVRAM<8*1024>(VRAMFlat_BOBJExtPal, &VRAMMap_BOBJExtPal, dirty);
 }
 }
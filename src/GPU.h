@@ -19,6 +19,8 @@
 #ifndef GPU_H
 #define GPU_H
 
+#include <algorithm>
+#include <atomic>
 #include <memory>
 
 #include "GPU2D.h"
@@ -72,7 +74,7 @@ public:
     u8* GetUniqueBankPtr(u32 mask, u32 offset) noexcept;
     const u8* GetUniqueBankPtr(u32 mask, u32 offset) const noexcept;
 
-    void SetRenderer2D(std::unique_ptr<GPU2D::Renderer2D>&& renderer) noexcept { GPU2D_Renderer = std::move(renderer); }
+    void SetRenderer2D(std::unique_ptr<GPU2D::Renderer2D>&& renderer) noexcept { GPU2D_Renderer = std::move(renderer); AssignFramebuffers(); }
     [[nodiscard]] const GPU2D::Renderer2D& GetRenderer2D() const noexcept { return *GPU2D_Renderer; }
     [[nodiscard]] GPU2D::Renderer2D& GetRenderer2D() noexcept { return *GPU2D_Renderer; }
 
@@ -241,6 +243,15 @@ public:
     {
         u32 mask = VRAMMap_ABG[(addr >> 14) & 0x1F];
 
+        if (u8* ptr = VRAMPtr_ABG[(addr >> 14) & 0x1F])
+        {
+            // only one bank is mapped here
+            u32 num = __builtin_ctz(mask);
+            VRAMDirty[num][(addr & VRAMMask[num]) / VRAMDirtyGranularity] = true;
+            *(T*)&ptr[addr & 0x3FFF] = val;
+            return;
+        }
+
         if (mask & (1<<0))
         {
             VRAMDirty[0][(addr & 0x1FFFF) / VRAMDirtyGranularity] = true;
@@ -302,6 +313,15 @@ public:
     {
         u32 mask = VRAMMap_AOBJ[(addr >> 14) & 0xF];
 
+        if (u8* ptr = VRAMPtr_AOBJ[(addr >> 14) & 0xF])
+        {
+            // only one bank is mapped here
+            u32 num = __builtin_ctz(mask);
+            VRAMDirty[num][(addr & VRAMMask[num]) / VRAMDirtyGranularity] = true;
+            *(T*)&ptr[addr & 0x3FFF] = val;
+            return;
+        }
+
         if (mask & (1<<0))
         {
             VRAMDirty[0][(addr & 0x1FFFF) / VRAMDirtyGranularity] = true;
@@ -351,6 +371,15 @@ public:
     {
         u32 mask = VRAMMap_BBG[(addr >> 14) & 0x7];
 
+        if (u8* ptr = VRAMPtr_BBG[(addr >> 14) & 0x7])
+        {
+            // only one bank is mapped here
+            u32 num = __builtin_ctz(mask);
+            VRAMDirty[num][(addr & VRAMMask[num]) / VRAMDirtyGranularity] = true;
+            *(T*)&ptr[addr & 0x3FFF] = val;
+            return;
+        }
+
         if (mask & (1<<2))
         {
             VRAMDirty[2][(addr & 0x1FFFF) / VRAMDirtyGranularity] = true;
@@ -389,6 +418,15 @@ public:
     {
         u32 mask = VRAMMap_BOBJ[(addr >> 14) & 0x7];
 
+        if (u8* ptr = VRAMPtr_BOBJ[(addr >> 14) & 0x7])
+        {
+            // only one bank is mapped here
+            u32 num = __builtin_ctz(mask);
+            VRAMDirty[num][(addr & VRAMMask[num]) / VRAMDirtyGranularity] = true;
+            *(T*)&ptr[addr & 0x3FFF] = val;
+            return;
+        }
+
         if (mask & (1<<3))
         {
             VRAMDirty[3][(addr & 0x1FFFF) / VRAMDirtyGranularity] = true;
@@ -504,6 +542,10 @@ public:
     void StartFrame() noexcept;
     void FinishFrame(u32 lines) noexcept;
     void BlankFrame() noexcept;
+    /// Redoes the rendering done during VBlank for the next frame (its 3D scene
+    /// and the sprites of its first scanline), for when a savestate saved at the
+    /// end of a frame was loaded and the renderers hold output from another one.
+    void RedoVBlankRendering() noexcept;
     void StartScanline(u32 line) noexcept;
     void StartHBlank(u32 line) noexcept;
 
@@ -570,13 +612,40 @@ public:
     u8* VRAMPtr_BBG[0x8] {};
     u8* VRAMPtr_BOBJ[0x8] {};
 
-    int FrontBuffer = 0;
-    std::unique_ptr<u32[]> Framebuffer[2][2] {};
+    // framebuffers are triple-buffered: the emulator draws into BackBuffer and
+    // publishes each finished frame, and the presenter takes the newest one through
+    // AcquireFrontBuffer(), so neither side ever waits for the other
+    int BackBuffer = 0;
+    std::unique_ptr<u32[]> Framebuffer[3][2] {};
+
+    /// Returns the index into Framebuffer of the newest finished frame.
+    /// The caller may read it until its next call, while emulation goes on.
+    /// Must only be called from one (presenting) thread.
+    int AcquireFrontBuffer() noexcept;
+
+    /// Returns the index the last AcquireFrontBuffer() call returned.
+    /// Only meant for the presenting thread, e.g. to composite that frame.
+    int GetPresentBuffer() const noexcept { return PresentBuffer; }
+
+    /// Number of finished frames that were replaced by a newer one before being acquired.
+    u64 GetDroppedFrames() const noexcept { return DroppedFrames.load(std::memory_order_relaxed); }
+
+    /// Number of AcquireFrontBuffer() calls that returned the same frame as the previous one.
+    u64 GetDuplicatedFrames() const noexcept { return DuplicatedFrames.load(std::memory_order_relaxed); }
+
+    // when set, 2D rendering is skipped for frames whose output will be discarded
+    // (rendering still happens when display capture needs it) and they aren't published
+    bool SuppressRendering = false; // not part of the hardware state, don't serialize
 
     GPU2D::Unit GPU2D_A;
     GPU2D::Unit GPU2D_B;
     melonDS::GPU3D GPU3D;
 
+    // per engine, incremented whenever its palette (BG or OBJ) or OAM was written to;
+    // updated from PaletteDirty/OAMDirty before the 2D renderer gets to draw
+    u32 PaletteGeneration[2] {};
+    u32 OAMGeneration[2] {};
+
     NonStupidBitField<128*1024/VRAMDirtyGranularity> VRAMDirty[9] {};
     VRAMTrackingSet<512*1024, 16*1024> VRAMDirty_ABG {};
     VRAMTrackingSet<256*1024, 16*1024> VRAMDirty_AOBJ {};
@@ -605,7 +674,17 @@ public:
     alignas(u64) u8 VRAMFlat_Texture[512*1024] {};
     alignas(u64) u8 VRAMFlat_TexPal[128*1024] {};
 private:
+    // index of the latest finished frame not owned by either side, plus PresentSlotFresh
+    // if the presenter hasn't taken it yet
+    static constexpr u32 PresentSlotFresh = 0x4;
+    std::atomic<u32> PresentSlot = 1;
+    int PresentBuffer = 2; // only touched by the presenting thread
+    std::atomic<u64> DroppedFrames = 0;
+    std::atomic<u64> DuplicatedFrames = 0;
+
+    void PublishFrame() noexcept;
     void ResetVRAMCache() noexcept;
+    void UpdateDirtyGenerations() noexcept;
     void AssignFramebuffers() noexcept;
     void InitFramebuffers() noexcept;
     template<typename T>
@@ -655,30 +734,71 @@ private:
         return ret;
     }
 
+    void CopyVRAMRun(u8* dst, u32 mapping, u32 offset, u32 len) const noexcept
+    {
+        if (!mapping)
+        {
+            memset(dst, 0, len);
+            return;
+        }
+
+        u32 num = __builtin_ctz(mapping);
+        mapping &= mapping - 1;
+        memcpy(dst, &VRAM[num][offset & VRAMMask[num]], len);
+
+        // several banks mapped to the same place are ORed together
+        // this loop is simple enough to get vectorised
+        while (mapping != 0)
+        {
+            num = __builtin_ctz(mapping);
+            mapping &= mapping - 1;
+
+            const u8* src = &VRAM[num][offset & VRAMMask[num]];
+            for (u32 i = 0; i < len; i += 8)
+                *(u64*)&dst[i] |= *(const u64*)&src[i];
+        }
+    }
+
     template <u32 MappingGranularity, u32 Size>
-    constexpr bool CopyLinearVRAM(u8* flat, const u32* mappings, NonStupidBitField<Size>& dirty, u64 (GPU::* const slowAccess)(u32) const noexcept) noexcept
+    constexpr bool CopyLinearVRAM(u8* flat, const u32* mappings, NonStupidBitField<Size>& dirty) noexcept
     {
         const u32 VRAMBitsPerMapping = MappingGranularity / VRAMDirtyGranularity;
+        using BitField = NonStupidBitField<Size>;
 
         bool change = false;
 
-        typename NonStupidBitField<Size>::Iterator it = dirty.Begin();
-        while (it != dirty.End())
+        // copy runs of consecutive dirty chunks at once
+        // a run ends at a mapping boundary, as the next part might come from other banks
+        for (u32 word = 0; word < BitField::DataLength; word++)
         {
-            u32 offset = *it * VRAMDirtyGranularity;
-            u8* dst = flat + offset;
-            u8* fastAccess = GetUniqueBankPtr(mappings[*it / VRAMBitsPerMapping], offset);
-            if (fastAccess)
-            {
-                memcpy(dst, fastAccess, VRAMDirtyGranularity);
-            }
-            else
+            if (!dirty.Data[word])
+                continue;
+
+            u32 i = word * 64;
+            u32 end = i + 64;
+            while (i < end)
             {
-                for (u32 i = 0; i < VRAMDirtyGranularity; i += 8)
-                    *(u64*)&dst[i] = (this->*slowAccess)(offset + i);
+                u64 bits = dirty.Data[word] >> (i & 0x3F);
+                if (!bits)
+                    break;
+
+                i += __builtin_ctzll(bits);
+                bits = ~(dirty.Data[word] >> (i & 0x3F));
+                u32 run = bits ? __builtin_ctzll(bits) : 64;
+
+                u32 start = i;
+                while (run > 0)
+                {
+                    u32 slot = i / VRAMBitsPerMapping;
+                    u32 len = std::min(run, (slot + 1) * VRAMBitsPerMapping - i);
+
+                    CopyVRAMRun(flat + i * VRAMDirtyGranularity, mappings[slot], i * VRAMDirtyGranularity, len * VRAMDirtyGranularity);
+                    i += len;
+                    run -= len;
+                }
+
+                change |= i > start;
             }
-            change = true;
-            it++;
         }
         return change;
     }
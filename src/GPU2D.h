@@ -126,6 +126,17 @@ private:
     melonDS::GPU& GPU;
 };
 
+/// Pixel formats the 2D renderer can write its output in.
+/// 32-bit formats are stored in native byte order with opaque alpha.
+/// 16-bit formats fill the first 512 bytes of each line, the line stride stays the same.
+enum class OutputFormat : u32
+{
+    BGRA8888,
+    RGBA8888,
+    RGB565,
+    XRGB1555,
+};
+
 class Renderer2D
 {
 public:
@@ -136,13 +147,24 @@ public:
 
     virtual void VBlankEnd(Unit* unitA, Unit* unitB) = 0;
 
+    /// Waits for any drawing handed off to another thread to complete.
+    /// Called at the end of each HBlank, before the emulated hardware
+    /// gets a chance to modify the state the renderer reads from.
+    virtual void Sync() {}
+
     void SetFramebuffer(u32* unitA, u32* unitB)
     {
         Framebuffer[0] = unitA;
         Framebuffer[1] = unitB;
     }
+
+    /// Selects the format of the finished lines. Has no effect when
+    /// compositing is done by an accelerated 3D renderer.
+    void SetOutputFormat(OutputFormat format) { Format = format; }
+    [[nodiscard]] OutputFormat GetOutputFormat() const { return Format; }
 protected:
     u32* Framebuffer[2];
+    OutputFormat Format = OutputFormat::BGRA8888;
 
     Unit* CurUnit;
 };
@@ -16,6 +16,9 @@
     with melonDS. If not, see http://www.gnu.org/licenses/.
 */
 
+#include <string.h>
+#include <algorithm>
+#include <type_traits>
 #include "GPU2D_Soft.h"
 #include "GPU.h"
 #include "GPU3D_OpenGL.h"
@@ -24,10 +27,190 @@ namespace melonDS
 {
 namespace GPU2D
 {
-SoftRenderer::SoftRenderer(melonDS::GPU& gpu)
-    : Renderer2D(), GPU(gpu)
+
+// the per-line color passes work on 4 pixels at once using the GCC/clang
+// vector extensions, which map to SSE2 on x86-64 and NEON on ARM64.
+// every operation is a lane-wise copy of the scalar helpers in GPU2D_Soft.h,
+// including the 32-bit wraparound, so the output is bit-identical.
+// 8-lane AVX2 versions would only save about 1% of a frame, which isn't worth
+// a second set of kernels plus runtime CPU detection.
+#if defined(__GNUC__) || defined(__clang__)
+#define GPU2D_SOFT_VECTORIZE
+
+typedef u32 u32x4 __attribute__((vector_size(16)));
+
+static inline u32x4 Load4(const u32* src)
+{
+    u32x4 ret;
+    memcpy(&ret, src, sizeof(ret));
+    return ret;
+}
+
+static inline void Store4(u32* dst, u32x4 val)
+{
+    memcpy(dst, &val, sizeof(val));
+}
+
+typedef u16 u16x4 __attribute__((vector_size(8)));
+
+// 15-bit VRAM pixels, widened to 32-bit lanes and back
+static inline u32x4 Load4(const u16* src)
+{
+    u16x4 ret;
+    memcpy(&ret, src, sizeof(ret));
+    return __builtin_convertvector(ret, u32x4);
+}
+
+static inline void Store4(u16* dst, u32x4 val)
+{
+    u16x4 narrow = __builtin_convertvector(val, u16x4);
+    memcpy(dst, &narrow, sizeof(narrow));
+}
+
+static inline u32x4 Splat4(u32 val)
+{
+    return u32x4{val, val, val, val};
+}
+
+// all bits set in lanes where val is nonzero
+static inline u32x4 IsSet4(u32x4 val)
+{
+    return (u32x4)(val != Splat4(0));
+}
+
+static inline bool Any4(u32x4 mask)
+{
+    return (mask[0] | mask[1] | mask[2] | mask[3]) != 0;
+}
+
+static inline u32x4 Select4(u32x4 mask, u32x4 a, u32x4 b)
+{
+    return (a & mask) | (b & ~mask);
+}
+
+static inline u32x4 Min4(u32x4 val, u32 max)
+{
+    return Select4((u32x4)(val > Splat4(max)), Splat4(max), val);
+}
+
+static inline u32x4 ColorBlend4x4(u32x4 val1, u32x4 val2, u32x4 eva, u32x4 evb)
+{
+    u32x4 r =  (((val1 & 0x00003F) * eva) + ((val2 & 0x00003F) * evb) + 0x000008) >> 4;
+    u32x4 g = ((((val1 & 0x003F00) * eva) + ((val2 & 0x003F00) * evb) + 0x000800) >> 4) & 0x007F00;
+    u32x4 b = ((((val1 & 0x3F0000) * eva) + ((val2 & 0x3F0000) * evb) + 0x080000) >> 4) & 0x7F0000;
+
+    return Min4(r, 0x00003F) | Min4(g, 0x003F00) | Min4(b, 0x3F0000) | 0xFF000000;
+}
+
+static inline u32x4 ColorBlend5x4(u32x4 val1, u32x4 val2)
+{
+    u32x4 eva = ((val1 >> 24) & 0x1F) + 1;
+    u32x4 evb = Splat4(32) - eva;
+
+    u32x4 r =  (((val1 & 0x00003F) * eva) + ((val2 & 0x00003F) * evb) + 0x000010) >> 5;
+    u32x4 g = ((((val1 & 0x003F00) * eva) + ((val2 & 0x003F00) * evb) + 0x001000) >> 5) & 0x007F00;
+    u32x4 b = ((((val1 & 0x3F0000) * eva) + ((val2 & 0x3F0000) * evb) + 0x100000) >> 5) & 0x7F0000;
+
+    u32x4 ret = Min4(r, 0x00003F) | Min4(g, 0x003F00) | Min4(b, 0x3F0000) | 0xFF000000;
+    return Select4((u32x4)(eva == Splat4(32)), val1, ret);
+}
+
+static inline u32x4 ColorBrightnessUpx4(u32x4 val, u32 factor, u32 bias)
+{
+    u32x4 rb = val & 0x3F003F;
+    u32x4 g = val & 0x003F00;
+
+    rb += (((((Splat4(0x3F003F) - rb) * factor) + (bias*0x010001)) >> 4) & 0x3F003F);
+    g +=  (((((Splat4(0x003F00) - g ) * factor) + (bias*0x000100)) >> 4) & 0x003F00);
+
+    return rb | g | 0xFF000000;
+}
+
+static inline u32x4 ColorBrightnessDownx4(u32x4 val, u32 factor, u32 bias)
+{
+    u32x4 rb = val & 0x3F003F;
+    u32x4 g = val & 0x003F00;
+
+    rb -= ((((rb * factor) + (bias*0x010001)) >> 4) & 0x3F003F);
+    g -=  ((((g  * factor) + (bias*0x000100)) >> 4) & 0x003F00);
+
+    return rb | g | 0xFF000000;
+}
+#endif
+
+SoftRenderer::SoftRenderer(melonDS::GPU& gpu, bool threaded)
+    : Renderer2D(), GPU(gpu), Threaded(threaded)
 {
     // mosaic table is initialized at compile-time
+
+    for (auto& cache : TileRowCache)
+        cache.fill({0xFFFFFFFF, 0, 0});
+
+    if (Threaded)
+    {
+        UnitBRenderer = std::make_unique<SoftRenderer>(gpu, false);
+        Sema_UnitBStart = Platform::Semaphore_Create();
+        Sema_UnitBDone = Platform::Semaphore_Create();
+
+        UnitBThreadRunning = true;
+        UnitBThread = Platform::Thread_Create([this]() { UnitBThreadFunc(); });
+    }
+}
+
+SoftRenderer::~SoftRenderer()
+{
+    if (UnitBThread)
+    {
+        Sync();
+
+        UnitBThreadRunning = false;
+        Platform::Semaphore_Post(Sema_UnitBStart);
+
+        Platform::Thread_Wait(UnitBThread);
+        Platform::Thread_Free(UnitBThread);
+    }
+
+    if (Sema_UnitBStart) Platform::Semaphore_Free(Sema_UnitBStart);
+    if (Sema_UnitBDone) Platform::Semaphore_Free(Sema_UnitBDone);
+}
+
+void SoftRenderer::PostUnitBJob(Unit* unit, u32 line, bool sprites)
+{
+    // the framebuffers are only swapped between frames, while the thread is idle
+    if (UnitBJobsPending == 0)
+    {
+        UnitBRenderer->SetFramebuffer(Framebuffer[0], Framebuffer[1]);
+        UnitBRenderer->SetOutputFormat(Format);
+    }
+
+    UnitBJobs[UnitBJobsPosted++ & 3] = {unit, line, sprites};
+    UnitBJobsPending++;
+    Platform::Semaphore_Post(Sema_UnitBStart);
+}
+
+void SoftRenderer::Sync()
+{
+    for (; UnitBJobsPending > 0; UnitBJobsPending--)
+        Platform::Semaphore_Wait(Sema_UnitBDone);
+}
+
+void SoftRenderer::UnitBThreadFunc()
+{
+    for (;;)
+    {
+        Platform::Semaphore_Wait(Sema_UnitBStart);
+        if (!UnitBThreadRunning) return;
+
+        // engine B only uses its own VRAM mappings, palette and OAM,
+        // so it can safely be drawn while engine A is drawn on the emulation thread
+        const UnitBJob& job = UnitBJobs[UnitBJobsDone++ & 3];
+        if (job.Sprites)
+            UnitBRenderer->DrawSprites(job.Line, job.Target);
+        else
+            UnitBRenderer->DrawScanline(job.Line, job.Target);
+
+        Platform::Semaphore_Post(Sema_UnitBDone);
+    }
 }
 
 u32 SoftRenderer::ColorComposite(int i, u32 val1, u32 val2) const
@@ -102,8 +285,266 @@ u32 SoftRenderer::ColorComposite(int i, u32 val1, u32 val2) const
     return val1;
 }
 
+void SoftRenderer::ColorCompositeLine(u32* dst, const u32* src1, const u32* src2) const
+{
+#ifdef GPU2D_SOFT_VECTORIZE
+    // same decision logic as ColorComposite(), evaluated as lane masks
+    u32 blendCnt = CurUnit->BlendCnt;
+    u32 effect = (blendCnt >> 6) & 0x3;
+    u32x4 blendCnt4 = Splat4(blendCnt);
+
+    for (int i = 0; i < 256; i+=4)
+    {
+        u32x4 val1 = Load4(&src1[i]);
+        u32x4 val2 = Load4(&src2[i]);
+        u32x4 winmask = {WindowMask[i], WindowMask[i+1], WindowMask[i+2], WindowMask[i+3]};
+
+        u32x4 flag1 = val1 >> 24;
+        u32x4 flag2 = val2 >> 24;
+
+        u32x4 target2 = Select4(IsSet4(flag2 & 0x80), Splat4(0x1000),
+                        Select4(IsSet4(flag2 & 0x40), Splat4(0x0100), flag2 << 8));
+        u32x4 hasTarget2 = IsSet4(blendCnt4 & target2);
+
+        u32x4 isOBJ = IsSet4(flag1 & 0x80);
+        u32x4 isAlpha = IsSet4(flag1 & 0x40);
+
+        u32x4 spriteBlend = isOBJ & hasTarget2;
+        u32x4 blend3D = ~isOBJ & isAlpha & hasTarget2;
+
+        u32x4 target1 = Select4(isOBJ, Splat4(0x10), Select4(isAlpha, Splat4(0x01), flag1));
+        u32x4 special = ~(spriteBlend | blend3D) & IsSet4(blendCnt4 & target1) & IsSet4(winmask & 0x20);
+
+        u32x4 ret = val1;
+
+        u32x4 blend = spriteBlend;
+        if (effect == 1) blend |= special & hasTarget2;
+        if (Any4(blend))
+        {
+            // bitmap sprites carry their own alpha
+            u32x4 spriteAlpha = spriteBlend & isAlpha;
+            u32x4 eva = Select4(spriteAlpha, flag1 & 0x1F, Splat4(CurUnit->EVA));
+            u32x4 evb = Select4(spriteAlpha, Splat4(16) - (flag1 & 0x1F), Splat4(CurUnit->EVB));
+
+            ret = Select4(blend, ColorBlend4x4(val1, val2, eva, evb), ret);
+        }
+
+        if (effect == 2 && Any4(special))
+            ret = Select4(special, ColorBrightnessUpx4(val1, CurUnit->EVY, 0x8), ret);
+        else if (effect == 3 && Any4(special))
+            ret = Select4(special, ColorBrightnessDownx4(val1, CurUnit->EVY, 0x7), ret);
+
+        if (Any4(blend3D))
+            ret = Select4(blend3D, ColorBlend5x4(val1, val2), ret);
+
+        Store4(&dst[i], ret);
+    }
+#else
+    for (int i = 0; i < 256; i++)
+        dst[i] = ColorComposite(i, src1[i], src2[i]);
+#endif
+}
+
+void SoftRenderer::ColorBrightnessUpLine(u32* line, u32 factor, u32 bias)
+{
+#ifdef GPU2D_SOFT_VECTORIZE
+    for (int i = 0; i < 256; i+=4)
+        Store4(&line[i], ColorBrightnessUpx4(Load4(&line[i]), factor, bias));
+#else
+    for (int i = 0; i < 256; i++)
+        line[i] = ColorBrightnessUp(line[i], factor, bias);
+#endif
+}
+
+void SoftRenderer::ColorBrightnessDownLine(u32* line, u32 factor, u32 bias)
+{
+#ifdef GPU2D_SOFT_VECTORIZE
+    for (int i = 0; i < 256; i+=4)
+        Store4(&line[i], ColorBrightnessDownx4(Load4(&line[i]), factor, bias));
+#else
+    for (int i = 0; i < 256; i++)
+        line[i] = ColorBrightnessDown(line[i], factor, bias);
+#endif
+}
+
+// 6-bit RGB to the given output format, the 8-bit formats get their top bits replicated
+// works the same on plain and vector colors
+template<OutputFormat format, typename T>
+static inline T ConvertColor(T c)
+{
+    if constexpr (format == OutputFormat::BGRA8888)
+    {
+        T r = (c << 18) & 0xFC0000;
+        T g = (c << 2) & 0xFC00;
+        T b = (c >> 14) & 0xFC;
+        c = r | g | b;
+
+        return c | ((c & 0xC0C0C0) >> 6) | 0xFF000000;
+    }
+    else if constexpr (format == OutputFormat::RGBA8888)
+    {
+        c = (c << 2) & 0xFCFCFC;
+
+        return c | ((c & 0xC0C0C0) >> 6) | 0xFF000000;
+    }
+    else if constexpr (format == OutputFormat::RGB565)
+    {
+        return ((c << 10) & 0xF800) | ((c >> 3) & 0x07E0) | ((c >> 17) & 0x001F);
+    }
+    else
+    {
+        return ((c << 9) & 0x7C00) | ((c >> 4) & 0x03E0) | ((c >> 17) & 0x001F) | 0x8000;
+    }
+}
+
+template<OutputFormat format>
+static void ConvertLineTo(u32* line)
+{
+    // 16-bit pixels are packed at the start of the line, each store lands behind the loads
+    constexpr bool narrow = (format == OutputFormat::RGB565) || (format == OutputFormat::XRGB1555);
+
+#ifdef GPU2D_SOFT_VECTORIZE
+    for (int i = 0; i < 256; i+=4)
+    {
+        u32x4 c = ConvertColor<format>(Load4(&line[i]));
+
+        if constexpr (narrow)
+            Store4(&((u16*)line)[i], c);
+        else
+            Store4(&line[i], c);
+    }
+#else
+    for (int i = 0; i < 256; i++)
+    {
+        u32 c = ConvertColor<format>(line[i]);
+
+        if constexpr (narrow)
+            ((u16*)line)[i] = c;
+        else
+            line[i] = c;
+    }
+#endif
+}
+
+void SoftRenderer::ConvertLine(u32* line, OutputFormat format)
+{
+    // note: BGRA is the default as it seems to be the most compatible
+    // (Direct2D soft, cairo...), embedders can pick what their textures use
+    switch (format)
+    {
+    case OutputFormat::BGRA8888: ConvertLineTo<OutputFormat::BGRA8888>(line); break;
+    case OutputFormat::RGBA8888: ConvertLineTo<OutputFormat::RGBA8888>(line); break;
+    case OutputFormat::RGB565:   ConvertLineTo<OutputFormat::RGB565>(line);   break;
+    case OutputFormat::XRGB1555: ConvertLineTo<OutputFormat::XRGB1555>(line); break;
+    }
+}
+
+void SoftRenderer::CaptureLineA(u16* dst, const u32* srcA, u32 width)
+{
+#ifdef GPU2D_SOFT_VECTORIZE
+    for (u32 i = 0; i < width; i+=4)
+    {
+        u32x4 val = Load4(&srcA[i]);
+
+        u32x4 r = (val >> 1) & 0x1F;
+        u32x4 g = (val >> 9) & 0x1F;
+        u32x4 b = (val >> 17) & 0x1F;
+        u32x4 a = IsSet4(val >> 24) & 0x8000;
+
+        Store4(&dst[i], r | (g << 5) | (b << 10) | a);
+    }
+#else
+    for (u32 i = 0; i < width; i++)
+    {
+        u32 val = srcA[i];
+
+        u32 r = (val >> 1) & 0x1F;
+        u32 g = (val >> 9) & 0x1F;
+        u32 b = (val >> 17) & 0x1F;
+        u32 a = ((val >> 24) != 0) ? 0x8000 : 0;
+
+        dst[i] = r | (g << 5) | (b << 10) | a;
+    }
+#endif
+}
+
+void SoftRenderer::CaptureLineAB(u16* dst, const u32* srcA, const u16* srcB, u32 width, u32 eva, u32 evb)
+{
+#ifdef GPU2D_SOFT_VECTORIZE
+    // the alpha bits select whether a source contributes at all, so they're used as lane masks
+    u32x4 alphaMaskA = Splat4(eva>0 ? 0x8000 : 0);
+    u32x4 alphaMaskB = Splat4(evb>0 ? 0x8000 : 0);
+
+    for (u32 i = 0; i < width; i+=4)
+    {
+        u32x4 valA = Load4(&srcA[i]);
+        u32x4 aA = IsSet4(valA >> 24);
+
+        u32x4 rD = (((valA >> 1) & 0x1F) * eva) & aA;
+        u32x4 gD = (((valA >> 9) & 0x1F) * eva) & aA;
+        u32x4 bD = (((valA >> 17) & 0x1F) * eva) & aA;
+        u32x4 aD = aA & alphaMaskA;
+
+        if (srcB)
+        {
+            u32x4 valB = Load4(&srcB[i]);
+            u32x4 aB = Splat4(0) - (valB >> 15);
+
+            rD += ((valB & 0x1F) * evb) & aB;
+            gD += (((valB >> 5) & 0x1F) * evb) & aB;
+            bD += (((valB >> 10) & 0x1F) * evb) & aB;
+            aD |= aB & alphaMaskB;
+        }
+
+        rD = Min4((rD + 8) >> 4, 0x1F);
+        gD = Min4((gD + 8) >> 4, 0x1F);
+        bD = Min4((bD + 8) >> 4, 0x1F);
+
+        Store4(&dst[i], rD | (gD << 5) | (bD << 10) | aD);
+    }
+#else
+    for (u32 i = 0; i < width; i++)
+    {
+        u32 val = srcA[i];
+
+        u32 rA = (val >> 1) & 0x1F;
+        u32 gA = (val >> 9) & 0x1F;
+        u32 bA = (val >> 17) & 0x1F;
+        u32 aA = ((val >> 24) != 0) ? 1 : 0;
+
+        u32 rB = 0, gB = 0, bB = 0, aB = 0;
+        if (srcB)
+        {
+            val = srcB[i];
+
+            rB = val & 0x1F;
+            gB = (val >> 5) & 0x1F;
+            bB = (val >> 10) & 0x1F;
+            aB = val >> 15;
+        }
+
+        u32 rD = ((rA * aA * eva) + (rB * aB * evb) + 8) >> 4;
+        u32 gD = ((gA * aA * eva) + (gB * aB * evb) + 8) >> 4;
+        u32 bD = ((bA * aA * eva) + (bB * aB * evb) + 8) >> 4;
+        u32 aD = (eva>0 ? aA : 0) | (evb>0 ? aB : 0);
+
+        if (rD > 0x1F) rD = 0x1F;
+        if (gD > 0x1F) gD = 0x1F;
+        if (bD > 0x1F) bD = 0x1F;
+
+        dst[i] = rD | (gD << 5) | (bD << 10) | (aD << 15);
+    }
+#endif
+}
+
 void SoftRenderer::DrawScanline(u32 line, Unit* unit)
 {
+    if (Threaded && unit->Num == 1)
+    {
+        PostUnitBJob(unit, line, false);
+        return;
+    }
+
     CurUnit = unit;
 
     int stride = GPU.GPU3D.IsRendererAccelerated() ? (256*3 + 1) : 256;
@@ -112,24 +553,28 @@ void SoftRenderer::DrawScanline(u32 line, Unit* unit)
     int n3dline = line;
     line = GPU.VCount;
 
+    bool vramChanged;
     if (CurUnit->Num == 0)
     {
         auto bgDirty = GPU.VRAMDirty_ABG.DeriveState(GPU.VRAMMap_ABG, GPU);
-        GPU.MakeVRAMFlat_ABGCoherent(bgDirty);
+        vramChanged = GPU.MakeVRAMFlat_ABGCoherent(bgDirty);
+        InvalidateTileRows(0, bgDirty);
         auto bgExtPalDirty = GPU.VRAMDirty_ABGExtPal.DeriveState(GPU.VRAMMap_ABGExtPal, GPU);
-        GPU.MakeVRAMFlat_ABGExtPalCoherent(bgExtPalDirty);
+        vramChanged |= GPU.MakeVRAMFlat_ABGExtPalCoherent(bgExtPalDirty);
         auto objExtPalDirty = GPU.VRAMDirty_AOBJExtPal.DeriveState(&GPU.VRAMMap_AOBJExtPal, GPU);
-        GPU.MakeVRAMFlat_AOBJExtPalCoherent(objExtPalDirty);
+        vramChanged |= GPU.MakeVRAMFlat_AOBJExtPalCoherent(objExtPalDirty);
     }
     else
     {
         auto bgDirty = GPU.VRAMDirty_BBG.DeriveState(GPU.VRAMMap_BBG, GPU);
-        GPU.MakeVRAMFlat_BBGCoherent(bgDirty);
+        vramChanged = GPU.MakeVRAMFlat_BBGCoherent(bgDirty);
+        InvalidateTileRows(1, bgDirty);
         auto bgExtPalDirty = GPU.VRAMDirty_BBGExtPal.DeriveState(GPU.VRAMMap_BBGExtPal, GPU);
-        GPU.MakeVRAMFlat_BBGExtPalCoherent(bgExtPalDirty);
+        vramChanged |= GPU.MakeVRAMFlat_BBGExtPalCoherent(bgExtPalDirty);
         auto objExtPalDirty = GPU.VRAMDirty_BOBJExtPal.DeriveState(&GPU.VRAMMap_BOBJExtPal, GPU);
-        GPU.MakeVRAMFlat_BOBJExtPalCoherent(objExtPalDirty);
+        vramChanged |= GPU.MakeVRAMFlat_BOBJExtPalCoherent(objExtPalDirty);
     }
+    if (vramChanged) VRAMGeneration[CurUnit->Num]++;
 
     bool forceblank = false;
 
@@ -170,6 +615,29 @@ void SoftRenderer::DrawScanline(u32 line, Unit* unit)
     u32 dispmode = CurUnit->DispCnt >> 16;
     dispmode &= (CurUnit->Num ? 0x1 : 0x3);
 
+    // lines can be reused if they only depend on state we keep track of:
+    // no 3D layer, no display capture and no VRAM/FIFO display
+    bool reusable = (dispmode == 1) && !CurUnit->CaptureLatch && !GPU.GPU3D.IsRendererAccelerated();
+    if (CurUnit->Num == 0 && (CurUnit->DispCnt & 0x108) == 0x108) reusable = false;
+
+    LineSignature sig;
+    if (reusable)
+    {
+        MakeLineSignature(sig, line);
+
+        u32 num = CurUnit->Num;
+        if (LineValid[num][n3dline] && !memcmp(&sig, &LineSignatures[num][n3dline], sizeof(sig)))
+        {
+            memcpy(dst, PrevLines[num][n3dline], 256*4);
+            // drawing would have moved the rotscale reference points on
+            memcpy(CurUnit->BGXRefInternal, PrevLineXRefs[num][n3dline], sizeof(CurUnit->BGXRefInternal));
+            memcpy(CurUnit->BGYRefInternal, PrevLineYRefs[num][n3dline], sizeof(CurUnit->BGYRefInternal));
+            CurUnit->UpdateMosaicCounters(line);
+            LineCacheHits[num]++;
+            return;
+        }
+    }
+
     // always render regular graphics
     DrawScanline_BGOBJ(line);
     CurUnit->UpdateMosaicCounters(line);
@@ -267,10 +735,7 @@ void SoftRenderer::DrawScanline(u32 line, Unit* unit)
             u32 factor = masterBrightness & 0x1F;
             if (factor > 16) factor = 16;
 
-            for (int i = 0; i < 256; i++)
-            {
-                dst[i] = ColorBrightnessUp(dst[i], factor, 0x0);
-            }
+            ColorBrightnessUpLine(dst, factor, 0x0);
         }
         else if ((masterBrightness >> 14) == 2)
         {
@@ -278,27 +743,82 @@ void SoftRenderer::DrawScanline(u32 line, Unit* unit)
             u32 factor = masterBrightness & 0x1F;
             if (factor > 16) factor = 16;
 
-            for (int i = 0; i < 256; i++)
-            {
-                dst[i] = ColorBrightnessDown(dst[i], factor, 0xF);
-            }
+            ColorBrightnessDownLine(dst, factor, 0xF);
         }
     }
 
-    // convert to 32-bit BGRA
-    // note: 32-bit RGBA would be more straightforward, but
-    // BGRA seems to be more compatible (Direct2D soft, cairo...)
-    for (int i = 0; i < 256; i+=2)
+    // convert to the output format
+    ConvertLine(dst, Format);
+
+    u32 num = CurUnit->Num;
+    if (reusable)
     {
-        u64 c = *(u64*)&dst[i];
+        memcpy(PrevLines[num][n3dline], dst, 256*4);
+        memcpy(PrevLineXRefs[num][n3dline], CurUnit->BGXRefInternal, sizeof(CurUnit->BGXRefInternal));
+        memcpy(PrevLineYRefs[num][n3dline], CurUnit->BGYRefInternal, sizeof(CurUnit->BGYRefInternal));
+        LineSignatures[num][n3dline] = sig;
+        LineValid[num][n3dline] = true;
+    }
+    else
+        LineValid[num][n3dline] = false;
 
-        u64 r = (c << 18) & 0xFC000000FC0000;
-        u64 g = (c << 2) & 0xFC000000FC00;
-        u64 b = (c >> 14) & 0xFC000000FC;
-        c = r | g | b;
+    LineCacheMisses[num]++;
+}
+
+void SoftRenderer::MakeLineSignature(LineSignature& sig, u32 line) const
+{
+    static_assert(std::has_unique_object_representations_v<LineSignature>,
+                  "line signatures are compared with memcmp and can't have padding");
+
+    u32 num = CurUnit->Num;
+
+    sig.Sprites = CurSprites[num];
+
+    sig.VCount = line;
+    sig.DispCnt = CurUnit->DispCnt;
+    sig.VRAMGeneration = VRAMGeneration[num];
+    sig.PaletteGeneration = GPU.PaletteGeneration[num];
+    sig.Win0Active = CurUnit->Win0Active;
+    sig.Win1Active = CurUnit->Win1Active;
+    sig.Format = Format;
+    memcpy(sig.BGXRefInternal, CurUnit->BGXRefInternal, sizeof(sig.BGXRefInternal));
+    memcpy(sig.BGYRefInternal, CurUnit->BGYRefInternal, sizeof(sig.BGYRefInternal));
+
+    memcpy(sig.BGCnt, CurUnit->BGCnt, sizeof(sig.BGCnt));
+    memcpy(sig.BGXPos, CurUnit->BGXPos, sizeof(sig.BGXPos));
+    memcpy(sig.BGYPos, CurUnit->BGYPos, sizeof(sig.BGYPos));
+    memcpy(sig.BGRotA, CurUnit->BGRotA, sizeof(sig.BGRotA));
+    memcpy(sig.BGRotB, CurUnit->BGRotB, sizeof(sig.BGRotB));
+    memcpy(sig.BGRotC, CurUnit->BGRotC, sizeof(sig.BGRotC));
+    memcpy(sig.BGRotD, CurUnit->BGRotD, sizeof(sig.BGRotD));
+    sig.BlendCnt = CurUnit->BlendCnt;
+    sig.MasterBrightness = CurUnit->MasterBrightness;
+
+    memcpy(sig.Win0Coords, CurUnit->Win0Coords, sizeof(sig.Win0Coords));
+    memcpy(sig.Win1Coords, CurUnit->Win1Coords, sizeof(sig.Win1Coords));
+    memcpy(sig.WinCnt, CurUnit->WinCnt, sizeof(sig.WinCnt));
+    memcpy(sig.BGMosaicSize, CurUnit->BGMosaicSize, sizeof(sig.BGMosaicSize));
+    memcpy(sig.OBJMosaicSize, CurUnit->OBJMosaicSize, sizeof(sig.OBJMosaicSize));
+    sig.BGMosaicY = CurUnit->BGMosaicY;
+    sig.BGMosaicYMax = CurUnit->BGMosaicYMax;
+    sig.OBJMosaicY = CurUnit->OBJMosaicY;
+    sig.OBJMosaicYMax = CurUnit->OBJMosaicYMax;
+    sig.EVA = CurUnit->EVA;
+    sig.EVB = CurUnit->EVB;
+    sig.EVY = CurUnit->EVY;
+    sig.Enabled = CurUnit->Enabled;
+}
 
-        *(u64*)&dst[i] = c | ((c & 0x00C0C0C000C0C0C0) >> 6) | 0xFF000000FF000000;
+void SoftRenderer::GetLineCacheStats(u32 num, u64& hits, u64& misses) const
+{
+    if (num == 1 && UnitBRenderer)
+    {
+        UnitBRenderer->GetLineCacheStats(num, hits, misses);
+        return;
     }
+
+    hits = LineCacheHits[num];
+    misses = LineCacheMisses[num];
 }
 
 void SoftRenderer::VBlankEnd(Unit* unitA, Unit* unitB)
@@ -419,50 +939,27 @@ void SoftRenderer::DoCapture(u32 line, u32 width)
     dstaddr &= 0xFFFF;
     srcBaddr &= 0xFFFF;
 
+    // both addresses are multiples of the capture width, so a line never
+    // wraps around the 64K window and can be handled as one contiguous run
+    dst += dstaddr;
+    if (srcB) srcB += srcBaddr;
+
     static_assert(VRAMDirtyGranularity == 512);
-    GPU.VRAMDirty[dstvram][(dstaddr * 2) / VRAMDirtyGranularity] = true;
+    for (u32 addr = dstaddr * 2; addr < (dstaddr + width) * 2; addr += VRAMDirtyGranularity)
+        GPU.VRAMDirty[dstvram][addr / VRAMDirtyGranularity] = true;
 
+    // TODO: check what happens when alpha=0
     switch ((captureCnt >> 29) & 0x3)
     {
     case 0: // source A
-        {
-            for (u32 i = 0; i < width; i++)
-            {
-                u32 val = srcA[i];
-
-                // TODO: check what happens when alpha=0
-
-                u32 r = (val >> 1) & 0x1F;
-                u32 g = (val >> 9) & 0x1F;
-                u32 b = (val >> 17) & 0x1F;
-                u32 a = ((val >> 24) != 0) ? 0x8000 : 0;
-
-                dst[dstaddr] = r | (g << 5) | (b << 10) | a;
-                dstaddr = (dstaddr + 1) & 0xFFFF;
-            }
-        }
+        CaptureLineA(dst, srcA, width);
         break;
 
     case 1: // source B
-        {
-            if (srcB)
-            {
-                for (u32 i = 0; i < width; i++)
-                {
-                    dst[dstaddr] = srcB[srcBaddr];
-                    srcBaddr = (srcBaddr + 1) & 0xFFFF;
-                    dstaddr = (dstaddr + 1) & 0xFFFF;
-                }
-            }
-            else
-            {
-                for (u32 i = 0; i < width; i++)
-                {
-                    dst[dstaddr] = 0;
-                    dstaddr = (dstaddr + 1) & 0xFFFF;
-                }
-            }
-        }
+        if (srcB)
+            memmove(dst, srcB, width*2);
+        else
+            memset(dst, 0, width*2);
         break;
 
     case 2: // sources A+B
@@ -475,62 +972,7 @@ void SoftRenderer::DoCapture(u32 line, u32 width)
             if (eva > 16) eva = 16;
             if (evb > 16) evb = 16;
 
-            if (srcB)
-            {
-                for (u32 i = 0; i < width; i++)
-                {
-                    u32 val = srcA[i];
-
-                    // TODO: check what happens when alpha=0
-
-                    u32 rA = (val >> 1) & 0x1F;
-                    u32 gA = (val >> 9) & 0x1F;
-                    u32 bA = (val >> 17) & 0x1F;
-                    u32 aA = ((val >> 24) != 0) ? 1 : 0;
-
-                    val = srcB[srcBaddr];
-
-                    u32 rB = val & 0x1F;
-                    u32 gB = (val >> 5) & 0x1F;
-                    u32 bB = (val >> 10) & 0x1F;
-                    u32 aB = val >> 15;
-
-                    u32 rD = ((rA * aA * eva) + (rB * aB * evb) + 8) >> 4;
-                    u32 gD = ((gA * aA * eva) + (gB * aB * evb) + 8) >> 4;
-                    u32 bD = ((bA * aA * eva) + (bB * aB * evb) + 8) >> 4;
-                    u32 aD = (eva>0 ? aA : 0) | (evb>0 ? aB : 0);
-
-                    if (rD > 0x1F) rD = 0x1F;
-                    if (gD > 0x1F) gD = 0x1F;
-                    if (bD > 0x1F) bD = 0x1F;
-
-                    dst[dstaddr] = rD | (gD << 5) | (bD << 10) | (aD << 15);
-                    srcBaddr = (srcBaddr + 1) & 0xFFFF;
-                    dstaddr = (dstaddr + 1) & 0xFFFF;
-                }
-            }
-            else
-            {
-                for (u32 i = 0; i < width; i++)
-                {
-                    u32 val = srcA[i];
-
-                    // TODO: check what happens when alpha=0
-
-                    u32 rA = (val >> 1) & 0x1F;
-                    u32 gA = (val >> 9) & 0x1F;
-                    u32 bA = (val >> 17) & 0x1F;
-                    u32 aA = ((val >> 24) != 0) ? 1 : 0;
-
-                    u32 rD = ((rA * aA * eva) + 8) >> 4;
-                    u32 gD = ((gA * aA * eva) + 8) >> 4;
-                    u32 bD = ((bA * aA * eva) + 8) >> 4;
-                    u32 aD = (eva>0 ? aA : 0);
-
-                    dst[dstaddr] = rD | (gD << 5) | (bD << 10) | (aD << 15);
-                    dstaddr = (dstaddr + 1) & 0xFFFF;
-                }
-            }
+            CaptureLineAB(dst, srcA, srcB, width, eva, evb);
         }
         break;
     }
@@ -733,17 +1175,10 @@ void SoftRenderer::DrawScanline_BGOBJ(u32 line)
     }
 
     // color special effects
-    // can likely be optimized
 
     if (!GPU.GPU3D.IsRendererAccelerated())
     {
-        for (int i = 0; i < 256; i++)
-        {
-            u32 val1 = BGOBJLine[i];
-            u32 val2 = BGOBJLine[256+i];
-
-            BGOBJLine[i] = ColorComposite(i, val1, val2);
-        }
+        ColorCompositeLine(&BGOBJLine[0], &BGOBJLine[0], &BGOBJLine[256]);
     }
     else
     {
@@ -825,12 +1260,10 @@ void SoftRenderer::DrawScanline_BGOBJ(u32 line)
         }
         else
         {
+            ColorCompositeLine(&BGOBJLine[0], &BGOBJLine[0], &BGOBJLine[256]);
+
             for (int i = 0; i < 256; i++)
             {
-                u32 val1 = BGOBJLine[i];
-                u32 val2 = BGOBJLine[256+i];
-
-                BGOBJLine[i]     = ColorComposite(i, val1, val2);
                 BGOBJLine[256+i] = 0;
                 BGOBJLine[512+i] = 0x07000000;
             }
@@ -907,6 +1340,47 @@ void SoftRenderer::DrawBG_3D()
     }
 }
 
+template <u32 Size>
+void SoftRenderer::InvalidateTileRows(u32 num, NonStupidBitField<Size>& dirty)
+{
+    for (auto it = dirty.Begin(); it != dirty.End(); it++)
+        TileRowGeneration[num][*it]++;
+}
+
+template <bool bpp8>
+u64 SoftRenderer::GetTileRow(const u8* bgvram, u32 addr, bool hflip)
+{
+    u32 tag = addr | (hflip << 30) | (bpp8 << 31);
+    u32 gen = TileRowGeneration[CurUnit->Num][addr / 512];
+
+    TileRowCacheEntry& entry = TileRowCache[CurUnit->Num][(tag * 0x9E3779B1) >> 20];
+    if (entry.Tag == tag && entry.Generation == gen)
+        return entry.Pixels;
+
+    u64 pixels;
+    if (bpp8)
+    {
+        memcpy(&pixels, &bgvram[addr], 8);
+    }
+    else
+    {
+        u32 data;
+        memcpy(&data, &bgvram[addr], 4);
+
+        // spread the 4-bit indices to one byte each
+        pixels = data;
+        pixels = (pixels | (pixels << 16)) & 0x0000FFFF0000FFFF;
+        pixels = (pixels | (pixels << 8)) & 0x00FF00FF00FF00FF;
+        pixels = (pixels | (pixels << 4)) & 0x0F0F0F0F0F0F0F0F;
+    }
+
+    if (hflip)
+        pixels = __builtin_bswap64(pixels);
+
+    entry = {tag, gen, pixels};
+    return pixels;
+}
+
 template<bool mosaic, SoftRenderer::DrawPixel drawPixel>
 void SoftRenderer::DrawBG_Text(u32 line, u32 bgnum)
 {
@@ -964,7 +1438,40 @@ void SoftRenderer::DrawBG_Text(u32 line, u32 bgnum)
     u8 color;
     u32 lastxpos;
 
-    if (bgcnt & 0x0080)
+    if ((bgcnt & 0x0080) && !mosaic)
+    {
+        // 256-color, drawn a tile row at a time
+
+        for (int i = 0; i < 256;)
+        {
+            curtile = *(u16*)&bgvram[(tilemapaddr + ((xoff & 0xF8) >> 2) + ((xoff & widexmask) << 3)) & bgvrammask];
+
+            if (extpal) curpal = CurUnit->GetBGExtPal(extpalslot, curtile>>12);
+            else        curpal = pal;
+
+            pixelsaddr = tilesetaddr + ((curtile & 0x03FF) << 6)
+                                     + (((curtile & 0x0800) ? (7-(yoff&0x7)) : (yoff&0x7)) << 3);
+
+            u64 pixels = GetTileRow<true>(bgvram, pixelsaddr & bgvrammask, curtile & 0x0400);
+            if (!pixels)
+            {
+                // fully transparent
+                u32 n = std::min<u32>(8 - (xoff & 0x7), 256 - i);
+                i += n;
+                xoff += n;
+                continue;
+            }
+
+            for (u32 x = xoff & 0x7; x < 8 && i < 256; x++, i++, xoff++)
+            {
+                color = pixels >> (x << 3);
+
+                if (color && (WindowMask[i] & (1<<bgnum)))
+                    drawPixel(&BGOBJLine[i], curpal[color], 0x01000000<<bgnum);
+            }
+        }
+    }
+    else if (bgcnt & 0x0080)
     {
         // 256-color
 
@@ -1016,6 +1523,36 @@ void SoftRenderer::DrawBG_Text(u32 line, u32 bgnum)
             xoff++;
         }
     }
+    else if (!mosaic)
+    {
+        // 16-color, drawn a tile row at a time
+
+        for (int i = 0; i < 256;)
+        {
+            curtile = *(u16*)&bgvram[(tilemapaddr + ((xoff & 0xF8) >> 2) + ((xoff & widexmask) << 3)) & bgvrammask];
+            curpal = pal + ((curtile & 0xF000) >> 8);
+            pixelsaddr = tilesetaddr + ((curtile & 0x03FF) << 5)
+                                     + (((curtile & 0x0800) ? (7-(yoff&0x7)) : (yoff&0x7)) << 2);
+
+            u64 pixels = GetTileRow<false>(bgvram, pixelsaddr & bgvrammask, curtile & 0x0400);
+            if (!pixels)
+            {
+                // fully transparent
+                u32 n = std::min<u32>(8 - (xoff & 0x7), 256 - i);
+                i += n;
+                xoff += n;
+                continue;
+            }
+
+            for (u32 x = xoff & 0x7; x < 8 && i < 256; x++, i++, xoff++)
+            {
+                color = pixels >> (x << 3);
+
+                if (color && (WindowMask[i] & (1<<bgnum)))
+                    drawPixel(&BGOBJLine[i], curpal[color], 0x01000000<<bgnum);
+            }
+        }
+    }
     else
     {
         // 16-color
@@ -1568,6 +2105,21 @@ void SoftRenderer::InterleaveSprites(u32 prio)
     }
 }
 
+static constexpr s32 SpriteWidth[16] =
+{
+    8, 16, 8, 8,
+    16, 32, 8, 8,
+    32, 32, 16, 8,
+    64, 64, 32, 8
+};
+static constexpr s32 SpriteHeight[16] =
+{
+    8, 8, 16, 8,
+    16, 8, 32, 8,
+    32, 16, 32, 8,
+    64, 32, 64, 8
+};
+
 #define DoDrawSprite(type, ...) \
     if (iswin) \
     { \
@@ -1580,6 +2132,12 @@ void SoftRenderer::InterleaveSprites(u32 prio)
 
 void SoftRenderer::DrawSprites(u32 line, Unit* unit)
 {
+    if (Threaded && unit->Num == 1)
+    {
+        PostUnitBJob(unit, line, true);
+        return;
+    }
+
     CurUnit = unit;
 
     if (line == 0)
@@ -1594,16 +2152,29 @@ void SoftRenderer::DrawSprites(u32 line, Unit* unit)
         CurUnit->OBJMosaicYCount = 0;
     }
 
+    bool vramChanged;
     if (CurUnit->Num == 0)
     {
         auto objDirty = GPU.VRAMDirty_AOBJ.DeriveState(GPU.VRAMMap_AOBJ, GPU);
-        GPU.MakeVRAMFlat_AOBJCoherent(objDirty);
+        vramChanged = GPU.MakeVRAMFlat_AOBJCoherent(objDirty);
     }
     else
     {
         auto objDirty = GPU.VRAMDirty_BOBJ.DeriveState(GPU.VRAMMap_BOBJ, GPU);
-        GPU.MakeVRAMFlat_BOBJCoherent(objDirty);
+        vramChanged = GPU.MakeVRAMFlat_BOBJCoherent(objDirty);
     }
+    if (vramChanged) VRAMGeneration[CurUnit->Num]++;
+
+    // remember what this sprite line was drawn from, for whole-line reuse
+    SpriteSignature& sprites = CurSprites[CurUnit->Num];
+    sprites.DispCnt = CurUnit->DispCnt;
+    sprites.VRAMGeneration = VRAMGeneration[CurUnit->Num];
+    sprites.PaletteGeneration = GPU.PaletteGeneration[CurUnit->Num];
+    sprites.OAMGeneration = GPU.OAMGeneration[CurUnit->Num];
+    sprites.OBJMosaicSize[0] = CurUnit->OBJMosaicSize[0];
+    sprites.OBJMosaicSize[1] = CurUnit->OBJMosaicSize[1];
+    sprites.OBJMosaicY = CurUnit->OBJMosaicY;
+    sprites.OBJMosaicYCount = CurUnit->OBJMosaicYCount;
 
     NumSprites[CurUnit->Num] = 0;
     memset(OBJLine[CurUnit->Num], 0, 256*4);
@@ -1612,94 +2183,104 @@ void SoftRenderer::DrawSprites(u32 line, Unit* unit)
 
     u16* oam = (u16*)&GPU.OAM[CurUnit->Num ? 0x400 : 0];
 
-    const s32 spritewidth[16] =
-    {
-        8, 16, 8, 8,
-        16, 32, 8, 8,
-        32, 32, 16, 8,
-        64, 64, 32, 8
-    };
-    const s32 spriteheight[16] =
-    {
-        8, 8, 16, 8,
-        16, 8, 32, 8,
-        32, 16, 32, 8,
-        64, 32, 64, 8
-    };
+    if (!SpriteBinsValid[CurUnit->Num] || SpriteBinsGeneration[CurUnit->Num] != GPU.OAMGeneration[CurUnit->Num])
+        BinSprites(oam);
 
-    for (int bgnum = 0x0C00; bgnum >= 0x0000; bgnum -= 0x0400)
+    // go through the sprites on this line by decreasing priority value, then decreasing number
+    const auto& bins = SpriteBins[CurUnit->Num][line & 0xFF];
+    for (int prio = 3; prio >= 0; prio--)
     {
-        for (int sprnum = 127; sprnum >= 0; sprnum--)
+        for (int half = 1; half >= 0; half--)
         {
-            u16* attrib = &oam[sprnum*4];
+            u64 mask = bins[prio][half];
+            while (mask)
+            {
+                int bit = 63 - __builtin_clzll(mask);
+                mask &= ~(1ULL << bit);
 
-            if ((attrib[2] & 0x0C00) != bgnum)
-                continue;
+                int sprnum = (half << 6) | bit;
+                u16* attrib = &oam[sprnum*4];
 
-            bool iswin = (((attrib[0] >> 10) & 0x3) == 2);
+                bool iswin = (((attrib[0] >> 10) & 0x3) == 2);
 
-            u32 sprline;
-            if ((attrib[0] & 0x1000) && !iswin)
-            {
-                // apply Y mosaic
-                sprline = CurUnit->OBJMosaicY;
-            }
-            else
-                sprline = line;
+                u32 sprline;
+                if ((attrib[0] & 0x1000) && !iswin)
+                {
+                    // apply Y mosaic
+                    sprline = CurUnit->OBJMosaicY;
+                }
+                else
+                    sprline = line;
 
-            if (attrib[0] & 0x0100)
-            {
                 u32 sizeparam = (attrib[0] >> 14) | ((attrib[1] & 0xC000) >> 12);
-                s32 width = spritewidth[sizeparam];
-                s32 height = spriteheight[sizeparam];
-                s32 boundwidth = width;
-                s32 boundheight = height;
+                s32 width = SpriteWidth[sizeparam];
+                s32 height = SpriteHeight[sizeparam];
+                u32 ypos = (sprline - (attrib[0] & 0xFF)) & 0xFF;
+                s32 xpos = (s32)(attrib[1] << 23) >> 23;
 
-                if (attrib[0] & 0x0200)
+                if (attrib[0] & 0x0100)
                 {
-                    boundwidth <<= 1;
-                    boundheight <<= 1;
-                }
+                    s32 boundwidth = width;
+                    s32 boundheight = height;
 
-                u32 ypos = attrib[0] & 0xFF;
-                if (((line - ypos) & 0xFF) >= (u32)boundheight)
-                    continue;
-                ypos = (sprline - ypos) & 0xFF;
+                    if (attrib[0] & 0x0200)
+                    {
+                        boundwidth <<= 1;
+                        boundheight <<= 1;
+                    }
 
-                s32 xpos = (s32)(attrib[1] << 23) >> 23;
-                if (xpos <= -boundwidth)
-                    continue;
+                    if (xpos <= -boundwidth)
+                        continue;
 
-                u32 rotparamgroup = (attrib[1] >> 9) & 0x1F;
+                    DoDrawSprite(Rotscale, sprnum, boundwidth, boundheight, width, height, xpos, ypos);
+                }
+                else
+                {
+                    if (xpos <= -width)
+                        continue;
 
-                DoDrawSprite(Rotscale, sprnum, boundwidth, boundheight, width, height, xpos, ypos);
+                    DoDrawSprite(Normal, sprnum, width, height, xpos, ypos);
+                }
 
                 NumSprites[CurUnit->Num]++;
             }
-            else
-            {
-                if (attrib[0] & 0x0200)
-                    continue;
-
-                u32 sizeparam = (attrib[0] >> 14) | ((attrib[1] & 0xC000) >> 12);
-                s32 width = spritewidth[sizeparam];
-                s32 height = spriteheight[sizeparam];
+        }
+    }
+}
 
-                u32 ypos = attrib[0] & 0xFF;
-                if (((line - ypos) & 0xFF) >= (u32)height)
-                    continue;
-                ypos = (sprline - ypos) & 0xFF;
+void SoftRenderer::BinSprites(const u16* oam)
+{
+    auto& bins = SpriteBins[CurUnit->Num];
+    memset(bins, 0, sizeof(bins));
 
-                s32 xpos = (s32)(attrib[1] << 23) >> 23;
-                if (xpos <= -width)
-                    continue;
+    for (int sprnum = 0; sprnum < 128; sprnum++)
+    {
+        const u16* attrib = &oam[sprnum*4];
 
-                DoDrawSprite(Normal, sprnum, width, height, xpos, ypos);
+        u32 sizeparam = (attrib[0] >> 14) | ((attrib[1] & 0xC000) >> 12);
+        u32 height = SpriteHeight[sizeparam];
 
-                NumSprites[CurUnit->Num]++;
-            }
+        if (attrib[0] & 0x0100)
+        {
+            // double size
+            if (attrib[0] & 0x0200)
+                height <<= 1;
         }
+        else if (attrib[0] & 0x0200)
+        {
+            // disabled
+            continue;
+        }
+
+        u32 ypos = attrib[0] & 0xFF;
+        u32 prio = (attrib[2] >> 10) & 0x3;
+
+        for (u32 y = 0; y < height; y++)
+            bins[(ypos + y) & 0xFF][prio][sprnum >> 6] |= 1ULL << (sprnum & 0x3F);
     }
+
+    SpriteBinsGeneration[CurUnit->Num] = GPU.OAMGeneration[CurUnit->Num];
+    SpriteBinsValid[CurUnit->Num] = true;
 }
 
 template<bool window>
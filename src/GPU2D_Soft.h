@@ -18,7 +18,13 @@
 
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <memory>
+
 #include "GPU2D.h"
+#include "NonStupidBitfield.h"
+#include "Platform.h"
 
 namespace melonDS
 {
@@ -30,14 +36,109 @@ namespace GPU2D
 class SoftRenderer : public Renderer2D
 {
 public:
-    SoftRenderer(melonDS::GPU& gpu);
-    ~SoftRenderer() override {}
+    /// @param threaded If set, engine B is drawn on a separate thread
+    /// while engine A is drawn on the calling thread.
+    SoftRenderer(melonDS::GPU& gpu, bool threaded = false);
+    ~SoftRenderer() override;
 
     void DrawScanline(u32 line, Unit* unit) override;
     void DrawSprites(u32 line, Unit* unit) override;
     void VBlankEnd(Unit* unitA, Unit* unitB) override;
+    void Sync() override;
+
+    /// Returns how many scanlines of the given engine were reused from the
+    /// previous frame (hits) or had to be drawn (misses) since this renderer
+    /// was created. Only meant to be read between frames.
+    void GetLineCacheStats(u32 num, u64& hits, u64& misses) const;
 private:
     melonDS::GPU& GPU;
+
+    // threading
+    // engine B gets its own renderer, as all the line buffers below are scratch space
+    struct UnitBJob
+    {
+        Unit* Target;
+        u32 Line;
+        bool Sprites;
+    };
+
+    bool Threaded;
+    std::unique_ptr<SoftRenderer> UnitBRenderer = nullptr;
+    Platform::Thread* UnitBThread = nullptr;
+    std::atomic_bool UnitBThreadRunning = false;
+    Platform::Semaphore* Sema_UnitBStart = nullptr;
+    Platform::Semaphore* Sema_UnitBDone = nullptr;
+    std::array<UnitBJob, 4> UnitBJobs {};
+    u32 UnitBJobsPosted = 0; // only touched by the emulation thread
+    u32 UnitBJobsPending = 0; // ditto
+    u32 UnitBJobsDone = 0; // only touched by the engine B thread
+
+    void PostUnitBJob(Unit* unit, u32 line, bool sprites);
+    void UnitBThreadFunc();
+
+    // whole-line reuse
+    // a scanline is copied from the previous frame when everything it was drawn from is unchanged.
+    // the layout has no padding so signatures can be compared with memcmp
+    struct SpriteSignature
+    {
+        u32 DispCnt;
+        u32 VRAMGeneration;
+        u32 PaletteGeneration;
+        u32 OAMGeneration;
+        u8 OBJMosaicSize[2];
+        u8 OBJMosaicY;
+        u8 OBJMosaicYCount;
+    };
+
+    struct LineSignature
+    {
+        SpriteSignature Sprites;
+
+        u32 VCount;
+        u32 DispCnt;
+        u32 VRAMGeneration;
+        u32 PaletteGeneration;
+        u32 Win0Active;
+        u32 Win1Active;
+        OutputFormat Format;
+        s32 BGXRefInternal[2];
+        s32 BGYRefInternal[2];
+
+        u16 BGCnt[4];
+        u16 BGXPos[4];
+        u16 BGYPos[4];
+        s16 BGRotA[2];
+        s16 BGRotB[2];
+        s16 BGRotC[2];
+        s16 BGRotD[2];
+        u16 BlendCnt;
+        u16 MasterBrightness;
+
+        u8 Win0Coords[4];
+        u8 Win1Coords[4];
+        u8 WinCnt[4];
+        u8 BGMosaicSize[2];
+        u8 OBJMosaicSize[2];
+        u8 BGMosaicY, BGMosaicYMax;
+        u8 OBJMosaicY, OBJMosaicYMax;
+        u8 EVA, EVB, EVY;
+        u8 Enabled;
+    };
+
+    // bumped whenever any BG/OBJ VRAM or extended palette of an engine changes
+    u32 VRAMGeneration[2] {};
+    SpriteSignature CurSprites[2] {};
+    LineSignature LineSignatures[2][192] {};
+    bool LineValid[2][192] {};
+    alignas(8) u32 PrevLines[2][192][256];
+    // rotscale reference points after drawing each cached line
+    s32 PrevLineXRefs[2][192][2];
+    s32 PrevLineYRefs[2][192][2];
+    u64 LineCacheHits[2] {};
+    u64 LineCacheMisses[2] {};
+
+    void MakeLineSignature(LineSignature& sig, u32 line) const;
+
     alignas(8) u32 BGOBJLine[256*3];
     u32* _3DLine;
 
@@ -48,6 +149,25 @@ private:
 
     u32 NumSprites[2];
 
+    // decoded text BG tile rows, as 8 color indices in screen order
+    // entries are checked against a generation counter for each 512-byte
+    // chunk of flat BG VRAM, bumped whenever the chunk gets dirty
+    struct TileRowCacheEntry
+    {
+        u32 Tag;
+        u32 Generation;
+        u64 Pixels;
+    };
+
+    static constexpr u32 TileRowCacheSize = 4096;
+    std::array<TileRowCacheEntry, TileRowCacheSize> TileRowCache[2] {};
+    std::array<u32, 512*1024/512> TileRowGeneration[2] {};
+
+    template <u32 Size>
+    void InvalidateTileRows(u32 num, NonStupidBitField<Size>& dirty);
+    template <bool bpp8>
+    u64 GetTileRow(const u8* bgvram, u32 addr, bool hflip);
+
     u8* CurBGXMosaicTable;
     array2d<u8, 16, 256> MosaicTable = []() constexpr
     {
@@ -119,6 +239,17 @@ private:
     }
     u32 ColorComposite(int i, u32 val1, u32 val2) const;
 
+    // whole-line versions of the above, vectorized where the compiler allows it
+    void ColorCompositeLine(u32* dst, const u32* src1, const u32* src2) const;
+    static void ColorBrightnessUpLine(u32* line, u32 factor, u32 bias);
+    static void ColorBrightnessDownLine(u32* line, u32 factor, u32 bias);
+    static void ConvertLine(u32* line, OutputFormat format);
+
+    // display capture kernels, converting/blending width pixels into 15-bit VRAM
+    // without srcB, CaptureLineAB blends source A against black
+    static void CaptureLineA(u16* dst, const u32* srcA, u32 width);
+    static void CaptureLineAB(u16* dst, const u32* srcA, const u16* srcB, u32 width, u32 eva, u32 evb);
+
     template<u32 bgmode> void DrawScanlineBGMode(u32 line);
     void DrawScanlineBGMode6(u32 line);
     void DrawScanlineBGMode7(u32 line);
@@ -135,6 +266,13 @@ private:
     template<bool mosaic, DrawPixel drawPixel> void DrawBG_Extended(u32 line, u32 bgnum);
     template<bool mosaic, DrawPixel drawPixel> void DrawBG_Large(u32 line);
 
+    // sprites intersecting each scanline as bitmasks of OAM entries, per priority
+    // rebuilt whenever the engine's OAM changes
+    u64 SpriteBins[2][256][4][2];
+    u32 SpriteBinsGeneration[2] {};
+    bool SpriteBinsValid[2] {};
+    void BinSprites(const u16* oam);
+
     void ApplySpriteMosaicX();
     template<DrawPixel drawPixel>
     void InterleaveSprites(u32 prio);
@@ -25,6 +25,9 @@
 #include "GPU3D_Soft.h"
 #include "Platform.h"
 
+#define XXH_STATIC_LINKING_ONLY
+#include "xxhash/xxhash.h"
+
 namespace melonDS
 {
 using Platform::Log;
@@ -163,6 +166,7 @@ void GPU3D::SetCurrentRenderer(std::unique_ptr<Renderer3D>&& renderer) noexcept
 {
     CurrentRenderer = std::move(renderer);
     CurrentRenderer->Reset(NDS.GPU);
+    RenderSceneHash = 0;
 }
 
 void GPU3D::ResetRenderingState() noexcept
@@ -182,6 +186,8 @@ void GPU3D::ResetRenderingState() noexcept
 
     RenderClearAttr1 = 0x3F000000;
     RenderClearAttr2 = 0x00007FFF;
+
+    RenderSceneHash = 0;
 }
 
 void GPU3D::Reset() noexcept
@@ -274,6 +280,7 @@ void GPU3D::Reset() noexcept
 
     UseShininessTable = false;
     memset(ShininessTable, 0, sizeof(ShininessTable));
+    InvalidateLightingCache();
 
     PolygonAttr = 0;
     CurPolygonAttr = 0;
@@ -526,6 +533,15 @@ void GPU3D::DoSavestate(Savestate* file) noexcept
 
             RenderPolygonRAM[i] = index == UINT32_MAX ? nullptr : &PolygonRAM[index];
         }
+
+        // older savestates still have degenerate polygons in the render list
+        u32 numpolys = 0;
+        for (u32 i = 0; i < RenderNumPolygons; i++)
+        {
+            if (!RenderPolygonRAM[i]->Degenerate)
+                RenderPolygonRAM[numpolys++] = RenderPolygonRAM[i];
+        }
+        RenderNumPolygons = numpolys;
     }
 
     file->VarArray(CurVertex, sizeof(s16)*3);
@@ -543,6 +559,8 @@ void GPU3D::DoSavestate(Savestate* file) noexcept
 
     file->Bool32(&UseShininessTable);
     file->VarArray(ShininessTable, 128*sizeof(u8));
+    if (!file->Saving)
+        InvalidateLightingCache();
 
     file->Bool32(&AbortFrame);
     file->Bool32(&GeometryEnabled);
@@ -553,6 +571,7 @@ void GPU3D::DoSavestate(Savestate* file) noexcept
     file->Var32(&TexParam);
     file->Var32(&TexPalette);
     RenderFrameIdentical = false;
+    RenderSceneHash = 0;
     if (softRenderer && softRenderer->IsThreaded())
     {
         softRenderer->EnableRenderThread();
@@ -694,6 +713,15 @@ void MatrixTranslate(s32* m, s32* s)
     m[15] += ((s64)s[0]*m[3] + (s64)s[1]*m[7] + (s64)s[2]*m[11]) >> 12;
 }
 
+// out = (x, y, z, 1) * m
+void MatrixTransform(s32* out, const s32* m, s32 x, s32 y, s32 z)
+{
+    out[0] = ((s64)x*m[0] + (s64)y*m[4] + (s64)z*m[8] + (s64)0x1000*m[12]) >> 12;
+    out[1] = ((s64)x*m[1] + (s64)y*m[5] + (s64)z*m[9] + (s64)0x1000*m[13]) >> 12;
+    out[2] = ((s64)x*m[2] + (s64)y*m[6] + (s64)z*m[10] + (s64)0x1000*m[14]) >> 12;
+    out[3] = ((s64)x*m[3] + (s64)y*m[7] + (s64)z*m[11] + (s64)0x1000*m[15]) >> 12;
+}
+
 void GPU3D::UpdateClipMatrix() noexcept
 {
     if (!ClipMatrixDirty) return;
@@ -833,6 +861,31 @@ void ClipSegment(Vertex* outbuf, Vertex* vin, Vertex* vout)
 #undef INTERPOLATE
 }
 
+// checkme
+static void RoundClippedColors(Vertex* vertices, int nverts)
+{
+    for (int i = 0; i < nverts; i++)
+    {
+        Vertex* vtx = &vertices[i];
+
+        vtx->Color[0] &= ~0xFFF; vtx->Color[0] += 0xFFF;
+        vtx->Color[1] &= ~0xFFF; vtx->Color[1] += 0xFFF;
+        vtx->Color[2] &= ~0xFFF; vtx->Color[2] += 0xFFF;
+    }
+}
+
+// which of the -X/+X/-Y/+Y/-Z/+Z planes the vertex is outside of
+static u32 ClipOutcode(const Vertex* vtx)
+{
+    u32 ret = 0;
+    for (int comp = 0; comp < 3; comp++)
+    {
+        if (vtx->Position[comp] < -vtx->Position[3]) ret |= (1 << (comp*2));
+        if (vtx->Position[comp] > vtx->Position[3])  ret |= (2 << (comp*2));
+    }
+    return ret;
+}
+
 template<int comp, bool attribs>
 int ClipAgainstPlane(const GPU3D& gpu, Vertex* vertices, int nverts, int clipstart)
 {
@@ -840,6 +893,20 @@ int ClipAgainstPlane(const GPU3D& gpu, Vertex* vertices, int nverts, int clipsta
     int prev, next;
     int c = clipstart;
 
+    // if no vertex crosses either side of this plane, both passes below
+    // would just copy the vertices around
+    // (a polygon already rejected by the far plane still goes through them,
+    // as they always keep the first clipstart vertices)
+    u32 outcode = 0;
+    for (int i = clipstart; i < nverts; i++)
+        outcode |= ClipOutcode(&vertices[i]);
+
+    if (nverts >= clipstart && !(outcode & (3 << (comp*2))))
+    {
+        RoundClippedColors(vertices, nverts);
+        return nverts;
+    }
+
     if (clipstart == 2)
     {
         temp[0] = vertices[0];
@@ -901,16 +968,7 @@ int ClipAgainstPlane(const GPU3D& gpu, Vertex* vertices, int nverts, int clipsta
             vertices[c++] = vtx;
     }
 
-    // checkme
-    for (int i = 0; i < c; i++)
-    {
-        Vertex* vtx = &vertices[i];
-
-        vtx->Color[0] &= ~0xFFF; vtx->Color[0] += 0xFFF;
-        vtx->Color[1] &= ~0xFFF; vtx->Color[1] += 0xFFF;
-        vtx->Color[2] &= ~0xFFF; vtx->Color[2] += 0xFFF;
-    }
-
+    RoundClippedColors(vertices, c);
     return c;
 }
 
@@ -927,6 +985,18 @@ int ClipPolygon(GPU3D& gpu, Vertex* vertices, int nverts, int clipstart)
     // some vertices that should get Y=-0x1000 get Y=0x1000 for some reason on hardware. it doesn't make sense.
     // clipping seems to process the Y plane before the X plane.
 
+    // fast path for polygons that are entirely inside the view volume,
+    // which is most of them
+    u32 outcode = 0;
+    for (int i = clipstart; i < nverts; i++)
+        outcode |= ClipOutcode(&vertices[i]);
+
+    if (!outcode)
+    {
+        RoundClippedColors(vertices, nverts);
+        return nverts;
+    }
+
     // Z clipping
     nverts = ClipAgainstPlane<2, attribs>(gpu, vertices, nverts, clipstart);
 
@@ -1358,10 +1428,7 @@ void GPU3D::SubmitVertex() noexcept
     Vertex* vertextrans = &TempVertexBuffer[VertexNumInPoly];
 
     UpdateClipMatrix();
-    vertextrans->Position[0] = (vertex[0]*ClipMatrix[0] + vertex[1]*ClipMatrix[4] + vertex[2]*ClipMatrix[8] + vertex[3]*ClipMatrix[12]) >> 12;
-    vertextrans->Position[1] = (vertex[0]*ClipMatrix[1] + vertex[1]*ClipMatrix[5] + vertex[2]*ClipMatrix[9] + vertex[3]*ClipMatrix[13]) >> 12;
-    vertextrans->Position[2] = (vertex[0]*ClipMatrix[2] + vertex[1]*ClipMatrix[6] + vertex[2]*ClipMatrix[10] + vertex[3]*ClipMatrix[14]) >> 12;
-    vertextrans->Position[3] = (vertex[0]*ClipMatrix[3] + vertex[1]*ClipMatrix[7] + vertex[2]*ClipMatrix[11] + vertex[3]*ClipMatrix[15]) >> 12;
+    MatrixTransform(vertextrans->Position, ClipMatrix, CurVertex[0], CurVertex[1], CurVertex[2]);
 
     // this probably shouldn't be.
     // the way color is handled during clipping needs investigation. TODO
@@ -1463,60 +1530,85 @@ void GPU3D::CalculateLighting() noexcept
     normaltrans[1] = (Normal[0]*VecMatrix[1] + Normal[1]*VecMatrix[5] + Normal[2]*VecMatrix[9]) >> 12;
     normaltrans[2] = (Normal[0]*VecMatrix[2] + Normal[1]*VecMatrix[6] + Normal[2]*VecMatrix[10]) >> 12;
 
-    VertexColor[0] = MatEmission[0];
-    VertexColor[1] = MatEmission[1];
-    VertexColor[2] = MatEmission[2];
-
-    s32 c = 0;
-    for (int i = 0; i < 4; i++)
-    {
-        if (!(CurPolygonAttr & (1<<i)))
-            continue;
-
-        // overflow handling (for example, if the normal length is >1)
-        // according to some hardware tests
-        // * diffuse level is saturated to 255
-        // * shininess level mirrors back to 0 and is ANDed with 0xFF, that before being squared
-        // TODO: check how it behaves when the computed shininess is >=0x200
-
-        s32 difflevel = (-(LightDirection[i][0]*normaltrans[0] +
-                         LightDirection[i][1]*normaltrans[1] +
-                         LightDirection[i][2]*normaltrans[2])) >> 10;
-        if (difflevel < 0) difflevel = 0;
-        else if (difflevel > 255) difflevel = 255;
-
-        s32 shinelevel = -(((LightDirection[i][0]>>1)*normaltrans[0] +
-                          (LightDirection[i][1]>>1)*normaltrans[1] +
-                          ((LightDirection[i][2]-0x200)>>1)*normaltrans[2]) >> 10);
-        if (shinelevel < 0) shinelevel = 0;
-        else if (shinelevel > 255) shinelevel = (0x100 - shinelevel) & 0xFF;
-        shinelevel = ((shinelevel * shinelevel) >> 7) - 0x100; // really (2*shinelevel*shinelevel)-1
-        if (shinelevel < 0) shinelevel = 0;
-
-        if (UseShininessTable)
+    u32 lightmask = CurPolygonAttr & 0xF;
+    s32 c = __builtin_popcount(lightmask);
+
+    u32 hash = ((u32)normaltrans[0] * 0x9E3779B1) ^ ((u32)normaltrans[1] * 0x85EBCA77) ^
+               ((u32)normaltrans[2] * 0xC2B2AE3D) ^ lightmask;
+    LightingCacheEntry& cached = LightingCache[(hash * 0x27D4EB2F) >> (32 - LightingCacheBits)];
+    if (cached.Generation == LightingCacheGeneration &&
+        cached.LightMask == lightmask &&
+        cached.Normal[0] == normaltrans[0] &&
+        cached.Normal[1] == normaltrans[1] &&
+        cached.Normal[2] == normaltrans[2])
+    {
+        VertexColor[0] = cached.Color[0];
+        VertexColor[1] = cached.Color[1];
+        VertexColor[2] = cached.Color[2];
+    }
+    else
+    {
+        VertexColor[0] = MatEmission[0];
+        VertexColor[1] = MatEmission[1];
+        VertexColor[2] = MatEmission[2];
+
+        for (int i = 0; i < 4; i++)
         {
-            // checkme
-            shinelevel >>= 1;
-            shinelevel = ShininessTable[shinelevel];
-        }
+            if (!(lightmask & (1<<i)))
+                continue;
+
+            // overflow handling (for example, if the normal length is >1)
+            // according to some hardware tests
+            // * diffuse level is saturated to 255
+            // * shininess level mirrors back to 0 and is ANDed with 0xFF, that before being squared
+            // TODO: check how it behaves when the computed shininess is >=0x200
+
+            s32 difflevel = (-(LightDirection[i][0]*normaltrans[0] +
+                             LightDirection[i][1]*normaltrans[1] +
+                             LightDirection[i][2]*normaltrans[2])) >> 10;
+            if (difflevel < 0) difflevel = 0;
+            else if (difflevel > 255) difflevel = 255;
+
+            s32 shinelevel = -(((LightDirection[i][0]>>1)*normaltrans[0] +
+                              (LightDirection[i][1]>>1)*normaltrans[1] +
+                              ((LightDirection[i][2]-0x200)>>1)*normaltrans[2]) >> 10);
+            if (shinelevel < 0) shinelevel = 0;
+            else if (shinelevel > 255) shinelevel = (0x100 - shinelevel) & 0xFF;
+            shinelevel = ((shinelevel * shinelevel) >> 7) - 0x100; // really (2*shinelevel*shinelevel)-1
+            if (shinelevel < 0) shinelevel = 0;
+
+            if (UseShininessTable)
+            {
+                // checkme
+                shinelevel >>= 1;
+                shinelevel = ShininessTable[shinelevel];
+            }
 
-        VertexColor[0] += ((MatSpecular[0] * LightColor[i][0] * shinelevel) >> 13);
-        VertexColor[0] += ((MatDiffuse[0] * LightColor[i][0] * difflevel) >> 13);
-        VertexColor[0] += ((MatAmbient[0] * LightColor[i][0]) >> 5);
+            VertexColor[0] += ((MatSpecular[0] * LightColor[i][0] * shinelevel) >> 13);
+            VertexColor[0] += ((MatDiffuse[0] * LightColor[i][0] * difflevel) >> 13);
+            VertexColor[0] += ((MatAmbient[0] * LightColor[i][0]) >> 5);
 
-        VertexColor[1] += ((MatSpecular[1] * LightColor[i][1] * shinelevel) >> 13);
-        VertexColor[1] += ((MatDiffuse[1] * LightColor[i][1] * difflevel) >> 13);
-        VertexColor[1] += ((MatAmbient[1] * LightColor[i][1]) >> 5);
+            VertexColor[1] += ((MatSpecular[1] * LightColor[i][1] * shinelevel) >> 13);
+            VertexColor[1] += ((MatDiffuse[1] * LightColor[i][1] * difflevel) >> 13);
+            VertexColor[1] += ((MatAmbient[1] * LightColor[i][1]) >> 5);
 
-        VertexColor[2] += ((MatSpecular[2] * LightColor[i][2] * shinelevel) >> 13);
-        VertexColor[2] += ((MatDiffuse[2] * LightColor[i][2] * difflevel) >> 13);
-        VertexColor[2] += ((MatAmbient[2] * LightColor[i][2]) >> 5);
+            VertexColor[2] += ((MatSpecular[2] * LightColor[i][2] * shinelevel) >> 13);
+            VertexColor[2] += ((MatDiffuse[2] * LightColor[i][2] * difflevel) >> 13);
+            VertexColor[2] += ((MatAmbient[2] * LightColor[i][2]) >> 5);
 
-        if (VertexColor[0] > 31) VertexColor[0] = 31;
-        if (VertexColor[1] > 31) VertexColor[1] = 31;
-        if (VertexColor[2] > 31) VertexColor[2] = 31;
+            if (VertexColor[0] > 31) VertexColor[0] = 31;
+            if (VertexColor[1] > 31) VertexColor[1] = 31;
+            if (VertexColor[2] > 31) VertexColor[2] = 31;
+        }
 
-        c++;
+        cached.Normal[0] = normaltrans[0];
+        cached.Normal[1] = normaltrans[1];
+        cached.Normal[2] = normaltrans[2];
+        cached.LightMask = lightmask;
+        cached.Generation = LightingCacheGeneration;
+        cached.Color[0] = VertexColor[0];
+        cached.Color[1] = VertexColor[1];
+        cached.Color[2] = VertexColor[2];
     }
 
     if (c < 1) c = 1;
@@ -1524,6 +1616,17 @@ void GPU3D::CalculateLighting() noexcept
     AddCycles(c);
 }
 
+void GPU3D::InvalidateLightingCache() noexcept
+{
+    LightingCacheGeneration++;
+    if (LightingCacheGeneration == 0)
+    {
+        // wrapped around, make sure no stale entry can match again
+        memset(LightingCache, 0, sizeof(LightingCache));
+        LightingCacheGeneration = 1;
+    }
+}
+
 
 void GPU3D::BoxTest(const u32* params) noexcept
 {
@@ -1561,10 +1664,7 @@ void GPU3D::BoxTest(const u32* params) noexcept
         s32 y = cube[i].Position[1];
         s32 z = cube[i].Position[2];
 
-        cube[i].Position[0] = ((s64)x*ClipMatrix[0] + (s64)y*ClipMatrix[4] + (s64)z*ClipMatrix[8] + (s64)0x1000*ClipMatrix[12]) >> 12;
-        cube[i].Position[1] = ((s64)x*ClipMatrix[1] + (s64)y*ClipMatrix[5] + (s64)z*ClipMatrix[9] + (s64)0x1000*ClipMatrix[13]) >> 12;
-        cube[i].Position[2] = ((s64)x*ClipMatrix[2] + (s64)y*ClipMatrix[6] + (s64)z*ClipMatrix[10] + (s64)0x1000*ClipMatrix[14]) >> 12;
-        cube[i].Position[3] = ((s64)x*ClipMatrix[3] + (s64)y*ClipMatrix[7] + (s64)z*ClipMatrix[11] + (s64)0x1000*ClipMatrix[15]) >> 12;
+        MatrixTransform(cube[i].Position, ClipMatrix, x, y, z);
     }
 
     // front face (-Z)
@@ -1624,13 +1724,8 @@ void GPU3D::BoxTest(const u32* params) noexcept
 
 void GPU3D::PosTest() noexcept
 {
-    s64 vertex[4] = {(s64)CurVertex[0], (s64)CurVertex[1], (s64)CurVertex[2], 0x1000};
-
     UpdateClipMatrix();
-    PosTestResult[0] = (vertex[0]*ClipMatrix[0] + vertex[1]*ClipMatrix[4] + vertex[2]*ClipMatrix[8] + vertex[3]*ClipMatrix[12]) >> 12;
-    PosTestResult[1] = (vertex[0]*ClipMatrix[1] + vertex[1]*ClipMatrix[5] + vertex[2]*ClipMatrix[9] + vertex[3]*ClipMatrix[13]) >> 12;
-    PosTestResult[2] = (vertex[0]*ClipMatrix[2] + vertex[1]*ClipMatrix[6] + vertex[2]*ClipMatrix[10] + vertex[3]*ClipMatrix[14]) >> 12;
-    PosTestResult[3] = (vertex[0]*ClipMatrix[3] + vertex[1]*ClipMatrix[7] + vertex[2]*ClipMatrix[11] + vertex[3]*ClipMatrix[15]) >> 12;
+    MatrixTransform(PosTestResult, ClipMatrix, CurVertex[0], CurVertex[1], CurVertex[2]);
 
     AddCycles(5);
 }
@@ -1982,6 +2077,7 @@ void GPU3D::ExecuteCommand() noexcept
             MatAmbient[0] = (entry.Param >> 16) & 0x1F;
             MatAmbient[1] = (entry.Param >> 21) & 0x1F;
             MatAmbient[2] = (entry.Param >> 26) & 0x1F;
+            InvalidateLightingCache();
             if (entry.Param & 0x8000)
             {
                 VertexColor[0] = MatDiffuse[0];
@@ -2000,6 +2096,7 @@ void GPU3D::ExecuteCommand() noexcept
             MatEmission[1] = (entry.Param >> 21) & 0x1F;
             MatEmission[2] = (entry.Param >> 26) & 0x1F;
             UseShininessTable = (entry.Param & 0x8000) != 0;
+            InvalidateLightingCache();
             AddCycles(3);
             break;
 
@@ -2014,6 +2111,7 @@ void GPU3D::ExecuteCommand() noexcept
                 LightDirection[l][0] = (dir[0]*VecMatrix[0] + dir[1]*VecMatrix[4] + dir[2]*VecMatrix[8]) >> 12;
                 LightDirection[l][1] = (dir[0]*VecMatrix[1] + dir[1]*VecMatrix[5] + dir[2]*VecMatrix[9]) >> 12;
                 LightDirection[l][2] = (dir[0]*VecMatrix[2] + dir[1]*VecMatrix[6] + dir[2]*VecMatrix[10]) >> 12;
+                InvalidateLightingCache();
             }
             AddCycles(5);
             break;
@@ -2025,6 +2123,7 @@ void GPU3D::ExecuteCommand() noexcept
                 LightColor[l][0] = entry.Param & 0x1F;
                 LightColor[l][1] = (entry.Param >> 5) & 0x1F;
                 LightColor[l][2] = (entry.Param >> 10) & 0x1F;
+                InvalidateLightingCache();
             }
             AddCycles(1);
             break;
@@ -2301,6 +2400,7 @@ void GPU3D::ExecuteCommand() noexcept
                             ShininessTable[i + 2] = (val >> 16) & 0xFF;
                             ShininessTable[i + 3] = val >> 24;
                         }
+                        InvalidateLightingCache();
                     }
                     break;
 
@@ -2406,9 +2506,19 @@ void GPU3D::VCount144(GPU& gpu) noexcept
 
 void GPU3D::RestartFrame(GPU& gpu) noexcept
 {
+    // the aborted frame may not have been fully rendered
+    RenderSceneHash = 0;
     CurrentRenderer->RestartFrame(gpu);
 }
 
+void GPU3D::RerenderFrame(GPU& gpu) noexcept
+{
+    // what the renderer holds may be from any other frame
+    RenderFrameIdentical = false;
+    RenderSceneHash = 0;
+    CurrentRenderer->RerenderFrame(gpu);
+}
+
 void GPU3D::Stop(const GPU& gpu) noexcept
 {
     if (CurrentRenderer)
@@ -2416,16 +2526,100 @@ void GPU3D::Stop(const GPU& gpu) noexcept
 }
 
 
-bool YSort(Polygon* a, Polygon* b)
+u64 GPU3D::HashRenderScene() const noexcept
 {
-    // polygon sorting rules:
-    // * opaque polygons come first
-    // * polygons with lower bottom Y come first
-    // * upon equal bottom Y, polygons with lower top Y come first
-    // * upon equal bottom AND top Y, original ordering is used
-    // the SortKey is calculated as to implement these rules
-
-    return a->SortKey < b->SortKey;
+    // everything from the polygons and vertices that the renderers use
+    XXH3_state_t state;
+    XXH3_64bits_reset(&state);
+    XXH3_64bits_update(&state, &RenderNumPolygons, sizeof(RenderNumPolygons));
+
+    for (u32 i = 0; i < RenderNumPolygons; i++)
+    {
+        const Polygon* poly = RenderPolygonRAM[i];
+        u32 buf[12 + 10*10];
+        u32 n = 0;
+
+        buf[n++] = poly->NumVertices;
+        buf[n++] = poly->Attr;
+        buf[n++] = poly->TexParam;
+        buf[n++] = poly->TexPalette;
+        buf[n++] = poly->WBuffer | (poly->FacingView << 1) | (poly->Translucent << 2) |
+                   (poly->IsShadowMask << 3) | (poly->IsShadow << 4) | (poly->Type << 8);
+        buf[n++] = poly->VTop;
+        buf[n++] = poly->VBottom;
+        buf[n++] = poly->YTop;
+        buf[n++] = poly->YBottom;
+        buf[n++] = poly->XTop;
+        buf[n++] = poly->XBottom;
+
+        for (u32 j = 0; j < poly->NumVertices; j++)
+        {
+            const Vertex* vtx = poly->Vertices[j];
+
+            buf[n++] = vtx->FinalPosition[0];
+            buf[n++] = vtx->FinalPosition[1];
+            buf[n++] = vtx->HiresPosition[0];
+            buf[n++] = vtx->HiresPosition[1];
+            buf[n++] = vtx->FinalColor[0];
+            buf[n++] = vtx->FinalColor[1];
+            buf[n++] = vtx->FinalColor[2];
+            buf[n++] = (u16)vtx->TexCoords[0] | ((u32)(u16)vtx->TexCoords[1] << 16);
+            buf[n++] = poly->FinalZ[j];
+            buf[n++] = poly->FinalW[j];
+        }
+
+        XXH3_64bits_update(&state, buf, n * sizeof(u32));
+    }
+
+    return XXH3_64bits_digest(&state);
+}
+
+// polygon sorting rules:
+// * opaque polygons come first
+// * polygons with lower bottom Y come first
+// * upon equal bottom Y, polygons with lower top Y come first
+// * upon equal bottom AND top Y, original ordering is used
+// the SortKey is calculated as to implement these rules: (ybot << 8) | ytop,
+// plus 0x10000 for translucent polygons. as it's only 17 bits, two stable
+// counting passes (top Y, then bottom Y and translucency) sort it fully.
+static void SortPolygons(Polygon** polygons, Polygon** tmp, u32 count)
+{
+    u32 histLo[256] {};
+    u32 histHi[512] {};
+
+    for (u32 i = 0; i < count; i++)
+    {
+        u32 key = polygons[i]->SortKey;
+        histLo[key & 0xFF]++;
+        histHi[(key >> 8) & 0x1FF]++;
+    }
+
+    auto pass = [count](u32* hist, u32 nbuckets, u32 shift, u32 mask, Polygon** src, Polygon** dst) -> bool
+    {
+        // nothing to do if all the polygons land in the same bucket
+        u32 sum = 0;
+        for (u32 i = 0; i < nbuckets; i++)
+        {
+            u32 num = hist[i];
+            if (num == count) return false;
+
+            hist[i] = sum;
+            sum += num;
+        }
+
+        for (u32 i = 0; i < count; i++)
+            dst[hist[(src[i]->SortKey >> shift) & mask]++] = src[i];
+
+        return true;
+    };
+
+    Polygon** cur = polygons;
+    Polygon** other = tmp;
+    if (pass(histLo, 256, 0, 0xFF, cur, other)) std::swap(cur, other);
+    if (pass(histHi, 512, 8, 0x1FF, cur, other)) std::swap(cur, other);
+
+    if (cur != polygons)
+        memcpy(polygons, cur, count * sizeof(Polygon*));
 }
 
 void GPU3D::VBlank() noexcept
@@ -2434,43 +2628,66 @@ void GPU3D::VBlank() noexcept
     {
         if (RenderingEnabled)
         {
+            bool sameregs = RenderDispCnt == DispCnt
+                && RenderAlphaRef == AlphaRef
+                && RenderClearAttr1 == ClearAttr1
+                && RenderClearAttr2 == ClearAttr2
+                && RenderFogColor == FogColor
+                && RenderFogOffset == FogOffset * 0x200
+                && memcmp(RenderEdgeTable, EdgeTable, 8*2) == 0
+                && memcmp(RenderFogDensityTable + 1, FogDensityTable, 32) == 0
+                && memcmp(RenderToonTable, ToonTable, 32*2) == 0;
+
             if (FlushRequest)
             {
+                u32 numpolys = 0, numopaque = 0;
                 if (NumPolygons)
                 {
-                    // separate translucent polygons from opaque ones
+                    // degenerate polygons are never rendered, drop them here.
+                    // opaque polygons go straight to the render list, translucent
+                    // ones are staged in the sort buffer and appended after them,
+                    // so the polygon RAM only needs to be walked once
 
-                    u32 io = 0, it = NumOpaquePolygons;
+                    u32 numtrans = 0;
                     for (u32 i = 0; i < NumPolygons; i++)
                     {
                         Polygon* poly = &CurPolygonRAM[i];
+                        if (poly->Degenerate) continue;
+
                         if (poly->Translucent)
-                            RenderPolygonRAM[it++] = poly;
+                            PolygonSortBuffer[numtrans++] = poly;
                         else
-                            RenderPolygonRAM[io++] = poly;
+                            RenderPolygonRAM[numopaque++] = poly;
                     }
 
+                    memcpy(&RenderPolygonRAM[numopaque], PolygonSortBuffer.data(), numtrans * sizeof(Polygon*));
+                    numpolys = numopaque + numtrans;
+
                     // apply Y-sorting
 
-                    std::stable_sort(RenderPolygonRAM.begin(),
-                        RenderPolygonRAM.begin() + ((FlushAttributes & 0x1) ? NumOpaquePolygons : NumPolygons),
-                        YSort);
+                    SortPolygons(RenderPolygonRAM.data(), PolygonSortBuffer.data(),
+                        (FlushAttributes & 0x1) ? numopaque : numpolys);
                 }
 
-                RenderNumPolygons = NumPolygons;
-                RenderFrameIdentical = false;
+                RenderNumPolygons = numpolys;
+
+                // a lot of games send the exact same scene again every frame.
+                // in that case, the renderer can keep what it has.
+                if (CurrentRenderer && CurrentRenderer->ReusesIdenticalFrames)
+                {
+                    u64 scenehash = HashRenderScene();
+                    RenderFrameIdentical = sameregs && RenderSceneHash != 0 && scenehash == RenderSceneHash;
+                    RenderSceneHash = scenehash;
+                }
+                else
+                {
+                    RenderFrameIdentical = false;
+                    RenderSceneHash = 0;
+                }
             }
             else
             {
-                RenderFrameIdentical = RenderDispCnt == DispCnt
-                    && RenderAlphaRef == AlphaRef
-                    && RenderClearAttr1 == ClearAttr1
-                    && RenderClearAttr2 == ClearAttr2
-                    && RenderFogColor == FogColor
-                    && RenderFogOffset == FogOffset * 0x200
-                    && memcmp(RenderEdgeTable, EdgeTable, 8*2) == 0
-                    && memcmp(RenderFogDensityTable + 1, FogDensityTable, 32) == 0
-                    && memcmp(RenderToonTable, ToonTable, 32*2) == 0;
+                RenderFrameIdentical = sameregs;
             }
 
             RenderDispCnt = DispCnt;
@@ -2560,40 +2777,69 @@ bool GPU3D::IsRendererAccelerated() const noexcept
 
 void GPU3D::WriteToGXFIFO(u32 val) noexcept
 {
-    if (NumCommands == 0)
-    {
-        NumCommands = 4;
-        CurCommand = val;
-        ParamCount = 0;
-        TotalParams = CmdNumParams[CurCommand & 0xFF];
+    WriteToGXFIFO(&val, 1);
+}
 
-        if (TotalParams > 0) return;
-    }
-    else
-        ParamCount++;
+u32 GPU3D::WriteToGXFIFO(const u32* vals, u32 count) noexcept
+{
+    if (!GeometryEnabled) return count;
 
-    for (;;)
+    u32 numcmds = NumCommands;
+    u32 curcmd = CurCommand;
+    u32 paramcount = ParamCount;
+    u32 totalparams = TotalParams;
+
+    u32 i = 0;
+    while (i < count)
     {
-        if ((CurCommand & 0xFF) || (NumCommands == 4 && CurCommand == 0))
+        u32 val = vals[i++];
+
+        if (numcmds == 0)
         {
-            CmdFIFOEntry entry;
-            entry.Command = CurCommand & 0xFF;
-            entry.Param = val;
-            CmdFIFOWrite(entry);
+            numcmds = 4;
+            curcmd = val;
+            paramcount = 0;
+            totalparams = CmdNumParams[curcmd & 0xFF];
+
+            if (totalparams > 0) continue;
         }
+        else
+            paramcount++;
 
-        if (ParamCount >= TotalParams)
+        for (;;)
         {
-            CurCommand >>= 8;
-            NumCommands--;
-            if (NumCommands == 0) break;
+            if ((curcmd & 0xFF) || (numcmds == 4 && curcmd == 0))
+            {
+                CmdFIFOEntry entry;
+                entry.Command = curcmd & 0xFF;
+                entry.Param = val;
+                CmdFIFOWrite(entry);
+            }
 
-            ParamCount = 0;
-            TotalParams = CmdNumParams[CurCommand & 0xFF];
+            if (paramcount >= totalparams)
+            {
+                curcmd >>= 8;
+                numcmds--;
+                if (numcmds == 0) break;
+
+                paramcount = 0;
+                totalparams = CmdNumParams[curcmd & 0xFF];
+            }
+            if (paramcount < totalparams)
+                break;
         }
-        if (ParamCount < TotalParams)
+
+        // the FIFO filled up and stalled the system, along with whatever
+        // was feeding us. the rest of the burst has to wait.
+        if (!CmdStallQueue.IsEmpty())
             break;
     }
+
+    NumCommands = numcmds;
+    CurCommand = curcmd;
+    ParamCount = paramcount;
+    TotalParams = totalparams;
+    return i;
 }
 
 
@@ -2973,8 +3219,8 @@ void GPU3D::Blit(const GPU& gpu) noexcept
         CurrentRenderer->Blit(gpu);
 }
 
-Renderer3D::Renderer3D(bool Accelerated)
-: Accelerated(Accelerated)
+Renderer3D::Renderer3D(bool Accelerated, bool ReusesIdenticalFrames)
+: Accelerated(Accelerated), ReusesIdenticalFrames(ReusesIdenticalFrames)
 { }
 
 }
@@ -108,6 +108,9 @@ public:
     void VCount215(GPU& gpu) noexcept;
 
     void RestartFrame(GPU& gpu) noexcept;
+    /// Renders the current frame again from scratch, discarding
+    /// whatever the renderer did since (e.g. after loading a savestate).
+    void RerenderFrame(GPU& gpu) noexcept;
     void Stop(const GPU& gpu) noexcept;
 
     void SetRenderXPos(u16 xpos) noexcept;
@@ -115,6 +118,10 @@ public:
     u32* GetLine(int line) noexcept;
 
     void WriteToGXFIFO(u32 val) noexcept;
+    /// Writes a burst of words to GXFIFO, as a DMA to 0x04000400 would.
+    /// Stops after the word that fills up the FIFO and stalls the system.
+    /// Returns the number of words that were taken.
+    u32 WriteToGXFIFO(const u32* vals, u32 count) noexcept;
 
     [[nodiscard]] bool IsRendererAccelerated() const noexcept;
     [[nodiscard]] Renderer3D& GetCurrentRenderer() noexcept { return *CurrentRenderer; }
@@ -149,9 +156,11 @@ private:
     void SubmitPolygon() noexcept;
     void SubmitVertex() noexcept;
     void CalculateLighting() noexcept;
+    void InvalidateLightingCache() noexcept;
     void BoxTest(const u32* params) noexcept;
     void PosTest() noexcept;
     void VecTest(u32 param) noexcept;
+    u64 HashRenderScene() const noexcept;
     void CmdFIFOWrite(const CmdFIFOEntry& entry) noexcept;
     CmdFIFOEntry CmdFIFORead() noexcept;
     void FinishWork(s32 cycles) noexcept;
@@ -272,6 +281,8 @@ public:
     u32 RenderClearAttr2 = 0;
 
     bool RenderFrameIdentical = false; // not part of the hardware state, don't serialize
+    // hash of the scene last handed to the renderer, 0 if there's nothing to compare against
+    u64 RenderSceneHash = 0; // not part of the hardware state, don't serialize
 
     bool AbortFrame = false;
 
@@ -295,6 +306,20 @@ public:
     bool UseShininessTable = false;
     u8 ShininessTable[128] {};
 
+    // vertex colors computed by CalculateLighting(), keyed by transformed normal
+    // and enabled lights. invalidated whenever the lights or the material change.
+    // not part of the hardware state, don't serialize
+    struct LightingCacheEntry
+    {
+        s32 Normal[3];
+        u32 LightMask;
+        u32 Generation;
+        u8 Color[3];
+    };
+    static constexpr u32 LightingCacheBits = 8;
+    LightingCacheEntry LightingCache[1 << LightingCacheBits] {};
+    u32 LightingCacheGeneration = 1;
+
     u32 PolygonAttr = 0;
     u32 CurPolygonAttr = 0;
 
@@ -320,8 +345,9 @@ public:
     u32 NumPolygons = 0;
     u32 CurRAMBank = 0;
 
-    std::array<Polygon*,2048> RenderPolygonRAM {};
+    std::array<Polygon*,2048> RenderPolygonRAM {}; // sorted, without degenerate polygons
     u32 RenderNumPolygons = 0;
+    std::array<Polygon*,2048> PolygonSortBuffer {}; // not part of the hardware state, don't serialize
 
     u32 FlushRequest = 0;
     u32 FlushAttributes = 0;
@@ -342,16 +368,20 @@ public:
     // be allocated differently and other little misc handlers. Ideally there
     // are more detailed "traits" that we can ask of the Renderer3D type
     const bool Accelerated;
+    // whether the renderer keeps its last frame when GPU3D reports the same scene again
+    // (RenderFrameIdentical); the scene is only hashed for renderers that do
+    const bool ReusesIdenticalFrames;
 
     virtual void VCount144(GPU& gpu) {};
     virtual void Stop(const GPU& gpu) {}
     virtual void RenderFrame(GPU& gpu) = 0;
     virtual void RestartFrame(GPU& gpu) {};
+    virtual void RerenderFrame(GPU& gpu) { RenderFrame(gpu); }
     virtual u32* GetLine(int line) = 0;
     virtual void Blit(const GPU& gpu) {};
     virtual void PrepareCaptureFrame() {}
 protected:
-    Renderer3D(bool Accelerated);
+    Renderer3D(bool Accelerated, bool ReusesIdenticalFrames = false);
 };
 
 }
@@ -1298,8 +1298,6 @@ void GLRenderer::RenderFrame(GPU& gpu)
         int firsttrans = -1;
         for (u32 i = 0; i < gpu.GPU3D.RenderNumPolygons; i++)
         {
-            if (gpu.GPU3D.RenderPolygonRAM[i]->Degenerate) continue;
-
             SetupPolygon(&PolygonList[npolys], gpu.GPU3D.RenderPolygonRAM[i]);
             if (firsttrans < 0 && gpu.GPU3D.RenderPolygonRAM[i]->Translucent)
                 firsttrans = npolys;
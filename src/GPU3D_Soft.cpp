@@ -96,7 +96,7 @@ void SoftRenderer::EnableRenderThread()
 }
 
 SoftRenderer::SoftRenderer(bool threaded) noexcept
-    : Renderer3D(false), Threaded(threaded)
+    : Renderer3D(false, true), Threaded(threaded)
 {
     Sema_RenderStart = Platform::Semaphore_Create();
     Sema_RenderDone = Platform::Semaphore_Create();
@@ -123,6 +123,7 @@ void SoftRenderer::Reset(GPU& gpu)
     memset(AttrBuffer, 0, BufferSize * 2 * 4);
 
     PrevIsShadowMask = false;
+    ClearImageDirty = true;
 
     SetupRenderThread(gpu);
     EnableRenderThread();
@@ -613,6 +614,8 @@ void SoftRenderer::SetupPolygonLeftEdge(SoftRenderer::RendererPolygon* rp, s32 y
         }
     }
 
+    rp->NextYL = polygon->Vertices[rp->NextVL]->FinalPosition[1];
+
     rp->XL = rp->SlopeL.Setup(polygon->Vertices[rp->CurVL]->FinalPosition[0], polygon->Vertices[rp->NextVL]->FinalPosition[0],
                               polygon->Vertices[rp->CurVL]->FinalPosition[1], polygon->Vertices[rp->NextVL]->FinalPosition[1],
                               polygon->FinalW[rp->CurVL], polygon->FinalW[rp->NextVL], y);
@@ -640,6 +643,8 @@ void SoftRenderer::SetupPolygonRightEdge(SoftRenderer::RendererPolygon* rp, s32
         }
     }
 
+    rp->NextYR = polygon->Vertices[rp->NextVR]->FinalPosition[1];
+
     rp->XR = rp->SlopeR.Setup(polygon->Vertices[rp->CurVR]->FinalPosition[0], polygon->Vertices[rp->NextVR]->FinalPosition[0],
                               polygon->Vertices[rp->CurVR]->FinalPosition[1], polygon->Vertices[rp->NextVR]->FinalPosition[1],
                               polygon->FinalW[rp->CurVR], polygon->FinalW[rp->NextVR], y);
@@ -687,6 +692,7 @@ void SoftRenderer::SetupPolygon(SoftRenderer::RendererPolygon* rp, Polygon* poly
 
         rp->CurVL = vtop; rp->NextVL = vtop;
         rp->CurVR = vbot; rp->NextVR = vbot;
+        rp->NextYL = ytop; rp->NextYR = ytop;
 
         rp->XL = rp->SlopeL.SetupDummy(polygon->Vertices[rp->CurVL]->FinalPosition[0]);
         rp->XR = rp->SlopeR.SetupDummy(polygon->Vertices[rp->CurVR]->FinalPosition[0]);
@@ -723,12 +729,12 @@ void SoftRenderer::RenderShadowMaskScanline(const GPU3D& gpu3d, RendererPolygon*
 
     if (polygon->YTop != polygon->YBottom)
     {
-        if (y >= polygon->Vertices[rp->NextVL]->FinalPosition[1] && rp->CurVL != polygon->VBottom)
+        if (y >= rp->NextYL && rp->CurVL != polygon->VBottom)
         {
             SetupPolygonLeftEdge(rp, y);
         }
 
-        if (y >= polygon->Vertices[rp->NextVR]->FinalPosition[1] && rp->CurVR != polygon->VBottom)
+        if (y >= rp->NextYR && rp->CurVR != polygon->VBottom)
         {
             SetupPolygonRightEdge(rp, y);
         }
@@ -948,12 +954,12 @@ void SoftRenderer::RenderPolygonScanline(const GPU& gpu, RendererPolygon* rp, s3
 
     if (polygon->YTop != polygon->YBottom)
     {
-        if (y >= polygon->Vertices[rp->NextVL]->FinalPosition[1] && rp->CurVL != polygon->VBottom)
+        if (y >= rp->NextYL && rp->CurVL != polygon->VBottom)
         {
             SetupPolygonLeftEdge(rp, y);
         }
 
-        if (y >= polygon->Vertices[rp->NextVR]->FinalPosition[1] && rp->CurVR != polygon->VBottom)
+        if (y >= rp->NextYR && rp->CurVR != polygon->VBottom)
         {
             SetupPolygonRightEdge(rp, y);
         }
@@ -1388,11 +1394,11 @@ void SoftRenderer::RenderScanline(const GPU& gpu, s32 y, int npolys)
 {
     for (int i = 0; i < npolys; i++)
     {
-        RendererPolygon* rp = &PolygonList[i];
-        Polygon* polygon = rp->PolyData;
-
-        if (y >= polygon->YTop && (y < polygon->YBottom || (y == polygon->YTop && polygon->YBottom == polygon->YTop)))
+        if (y >= PolygonLineStart[i] && y < PolygonLineEnd[i])
         {
+            RendererPolygon* rp = &PolygonList[i];
+            Polygon* polygon = rp->PolyData;
+
             if (polygon->IsShadowMask)
                 RenderShadowMaskScanline(gpu.GPU3D, rp, y);
             else
@@ -1645,32 +1651,33 @@ void SoftRenderer::ClearBuffers(const GPU& gpu)
 
     if (gpu.GPU3D.RenderDispCnt & (1<<14))
     {
+        if (ClearImageDirty)
+        {
+            UpdateClearImage(gpu);
+            ClearImageDirty = false;
+        }
+
         u8 xoff = (gpu.GPU3D.RenderClearAttr2 >> 16) & 0xFF;
         u8 yoff = (gpu.GPU3D.RenderClearAttr2 >> 24) & 0xFF;
 
+        // the bitmap wraps around, so each line is copied in two parts
+        u32 len1 = 256 - xoff;
+        u32 len2 = xoff;
+
         for (int y = 0; y < ScanlineWidth*192; y+=ScanlineWidth)
         {
-            for (int x = 0; x < 256; x++)
-            {
-                u16 val2 = ReadVRAM_Texture<u16>(0x40000 + (yoff << 9) + (xoff << 1), gpu);
-                u16 val3 = ReadVRAM_Texture<u16>(0x60000 + (yoff << 9) + (xoff << 1), gpu);
-
-                // TODO: confirm color conversion
-                u32 r = (val2 << 1) & 0x3E; if (r) r++;
-                u32 g = (val2 >> 4) & 0x3E; if (g) g++;
-                u32 b = (val2 >> 9) & 0x3E; if (b) b++;
-                u32 a = (val2 & 0x8000) ? 0x1F000000 : 0;
-                u32 color = r | (g << 8) | (b << 16) | a;
+            u32 pixeladdr = FirstPixelOffset + y;
+            u32 srcaddr = yoff << 8;
 
-                u32 z = ((val3 & 0x7FFF) * 0x200) + 0x1FF;
+            memcpy(&ColorBuffer[pixeladdr], &ClearColorImage[srcaddr + xoff], len1 * 4);
+            memcpy(&ColorBuffer[pixeladdr + len1], &ClearColorImage[srcaddr], len2 * 4);
+            memcpy(&DepthBuffer[pixeladdr], &ClearDepthImage[srcaddr + xoff], len1 * 4);
+            memcpy(&DepthBuffer[pixeladdr + len1], &ClearDepthImage[srcaddr], len2 * 4);
 
-                u32 pixeladdr = FirstPixelOffset + y + x;
-                ColorBuffer[pixeladdr] = color;
-                DepthBuffer[pixeladdr] = z;
-                AttrBuffer[pixeladdr] = polyid | (val3 & 0x8000);
-
-                xoff++;
-            }
+            for (u32 x = 0; x < len1; x++)
+                AttrBuffer[pixeladdr + x] = polyid | ClearFogImage[srcaddr + xoff + x];
+            for (u32 x = 0; x < len2; x++)
+                AttrBuffer[pixeladdr + len1 + x] = polyid | ClearFogImage[srcaddr + x];
 
             yoff++;
         }
@@ -1688,31 +1695,50 @@ void SoftRenderer::ClearBuffers(const GPU& gpu)
 
         for (int y = 0; y < ScanlineWidth*192; y+=ScanlineWidth)
         {
-            for (int x = 0; x < 256; x++)
-            {
-                u32 pixeladdr = FirstPixelOffset + y + x;
-                ColorBuffer[pixeladdr] = color;
-                DepthBuffer[pixeladdr] = clearz;
-                AttrBuffer[pixeladdr] = polyid;
-            }
+            u32 pixeladdr = FirstPixelOffset + y;
+            std::fill_n(&ColorBuffer[pixeladdr], 256, color);
+            std::fill_n(&DepthBuffer[pixeladdr], 256, clearz);
+            std::fill_n(&AttrBuffer[pixeladdr], 256, polyid);
         }
     }
 }
 
+void SoftRenderer::UpdateClearImage(const GPU& gpu)
+{
+    for (int i = 0; i < 256*256; i++)
+    {
+        u16 val2 = ReadVRAM_Texture<u16>(0x40000 + (i << 1), gpu);
+        u16 val3 = ReadVRAM_Texture<u16>(0x60000 + (i << 1), gpu);
+
+        // TODO: confirm color conversion
+        u32 r = (val2 << 1) & 0x3E; if (r) r++;
+        u32 g = (val2 >> 4) & 0x3E; if (g) g++;
+        u32 b = (val2 >> 9) & 0x3E; if (b) b++;
+        u32 a = (val2 & 0x8000) ? 0x1F000000 : 0;
+        ClearColorImage[i] = r | (g << 8) | (b << 16) | a;
+
+        ClearDepthImage[i] = ((val3 & 0x7FFF) * 0x200) + 0x1FF;
+        ClearFogImage[i] = val3 & 0x8000;
+    }
+}
+
 void SoftRenderer::RenderPolygons(const GPU& gpu, bool threaded, Polygon** polygons, int npolys)
 {
-    int j = 0;
     for (int i = 0; i < npolys; i++)
     {
-        if (polygons[i]->Degenerate) continue;
-        SetupPolygon(&PolygonList[j++], polygons[i]);
+        Polygon* polygon = polygons[i];
+        SetupPolygon(&PolygonList[i], polygon);
+
+        // flat polygons still cover the one scanline they're on
+        PolygonLineStart[i] = polygon->YTop;
+        PolygonLineEnd[i] = (polygon->YBottom == polygon->YTop) ? (polygon->YTop + 1) : polygon->YBottom;
     }
 
-    RenderScanline(gpu, 0, j);
+    RenderScanline(gpu, 0, npolys);
 
     for (s32 y = 1; y < 192; y++)
     {
-        RenderScanline(gpu, y, j);
+        RenderScanline(gpu, y, npolys);
         ScanlineFinalPass(gpu.GPU3D, y-1);
 
         if (threaded)
@@ -1743,6 +1769,13 @@ void SoftRenderer::RenderFrame(GPU& gpu)
 
     FrameIdentical = !(textureChanged || texPalChanged) && gpu.GPU3D.RenderFrameIdentical;
 
+    // the rear-plane bitmap lives in texture slots 2 and 3
+    for (u32 i = (0x40000 / VRAMDirtyGranularity) >> 6; i < textureDirty.DataLength; i++)
+    {
+        if (textureDirty.Data[i])
+            ClearImageDirty = true;
+    }
+
     if (RenderThreadRunning.load(std::memory_order_relaxed))
     {
         // "Render thread, you're up! Get moving."
@@ -1761,6 +1794,15 @@ void SoftRenderer::RestartFrame(GPU& gpu)
     EnableRenderThread();
 }
 
+void SoftRenderer::RerenderFrame(GPU& gpu)
+{
+    // the render thread may be anywhere in a frame, or have one queued up;
+    // start over with a fresh one so it doesn't hand out stale scanlines
+    StopRenderThread();
+    SetupRenderThread(gpu);
+    RenderFrame(gpu);
+}
+
 void SoftRenderer::RenderThreadFunc(GPU& gpu)
 {
     for (;;)
@@ -21,11 +21,33 @@
 #include "GPU.h"
 #include "GPU3D.h"
 #include "Platform.h"
+#include <array>
 #include <thread>
 #include <atomic>
 
 namespace melonDS
 {
+// reciprocals for the fixed-numerator divisions done when setting up edges and spans.
+// these are exact, the tables just save doing the same divisions over and over.
+constexpr int SoftRendererRecipTableSize = 512;
+
+template<int shift>
+inline constexpr std::array<s32, SoftRendererRecipTableSize> SoftRendererRecipTable = []() constexpr
+{
+    std::array<s32, SoftRendererRecipTableSize> table {};
+    for (int i = 1; i < SoftRendererRecipTableSize; i++)
+        table[i] = (1<<shift) / i;
+    return table;
+}();
+
+template<int shift>
+constexpr s32 SoftRendererRecip(s32 den)
+{
+    if (den > 0 && den < SoftRendererRecipTableSize)
+        return SoftRendererRecipTable<shift>[den];
+    return (1<<shift) / den;
+}
+
 class SoftRenderer : public Renderer3D
 {
 public:
@@ -39,6 +61,7 @@ public:
     void VCount144(GPU& gpu) override;
     void RenderFrame(GPU& gpu) override;
     void RestartFrame(GPU& gpu) override;
+    void RerenderFrame(GPU& gpu) override;
     u32* GetLine(int line) override;
 
     void SetupRenderThread(GPU& gpu);
@@ -81,9 +104,8 @@ private:
             this->xdiff = x1 - x0;
 
             // calculate reciprocal for Z interpolation
-            // TODO eventually: use a faster reciprocal function?
             if (this->xdiff != 0)
-                this->xrecip_z = (1<<22) / this->xdiff;
+                this->xrecip_z = SoftRendererRecip<22>(this->xdiff);
             else
                 this->xrecip_z = 0;
 
@@ -289,7 +311,7 @@ private:
                 Increment = 0x40000;
             else
             {
-                s32 yrecip = (1<<18) / ylen;
+                s32 yrecip = SoftRendererRecip<18>(ylen);
                 Increment = (x1-x0) * yrecip;
                 if (Increment < 0) Increment = -Increment;
             }
@@ -451,10 +473,15 @@ private:
         s32 XL, XR;
         u32 CurVL, CurVR;
         u32 NextVL, NextVR;
+        s32 NextYL, NextYR; // Y of the next vertex along each edge
 
     };
 
     RendererPolygon PolygonList[2048];
+    // scanlines covered by each polygon in PolygonList, as [start, end)
+    // kept apart so the per-scanline polygon loop doesn't have to touch the polygons
+    s32 PolygonLineStart[2048];
+    s32 PolygonLineEnd[2048];
     void TextureLookup(const GPU& gpu, u32 texparam, u32 texpal, s16 s, s16 t, u16* color, u8* alpha) const;
     u32 RenderPixel(const GPU& gpu, const Polygon* polygon, u8 vr, u8 vg, u8 vb, s16 s, s16 t) const;
     void PlotTranslucentPixel(const GPU3D& gpu3d, u32 pixeladdr, u32 color, u32 z, u32 polyattr, u32 shadow);
@@ -466,6 +493,7 @@ private:
     void RenderScanline(const GPU& gpu, s32 y, int npolys);
     u32 CalculateFogDensity(const GPU3D& gpu3d, u32 pixeladdr) const;
     void ScanlineFinalPass(const GPU3D& gpu3d, s32 y);
+    void UpdateClearImage(const GPU& gpu);
     void ClearBuffers(const GPU& gpu);
     void RenderPolygons(const GPU& gpu, bool threaded, Polygon** polygons, int npolys);
 
@@ -495,6 +523,13 @@ private:
     // bit22: translucent flag
     // bit24-29: polygon ID for opaque pixels
 
+    // rear-plane bitmap (texture slots 2 and 3), already converted to the buffer formats
+    // and scrolled into place by ClearBuffers(). rebuilt when that part of VRAM changes.
+    u32 ClearColorImage[256*256];
+    u32 ClearDepthImage[256*256];
+    u32 ClearFogImage[256*256];
+    bool ClearImageDirty = true;
+
     u8 StencilBuffer[256*2];
     bool PrevIsShadowMask;
 
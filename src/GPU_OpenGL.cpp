@@ -213,7 +213,7 @@ void GLCompositor::SetScaleFactor(int scale) noexcept
     ScreenW = 256 * scale;
     ScreenH = (384+2) * scale;
 
-    for (int i = 0; i < 2; i++)
+    for (size_t i = 0; i < CompScreenOutputTex.size(); i++)
     {
         glBindTexture(GL_TEXTURE_2D, CompScreenOutputTex[i]);
         glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, ScreenW, ScreenH, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
@@ -233,10 +233,10 @@ void GLCompositor::SetScaleFactor(int scale) noexcept
 
 void GLCompositor::Stop(const GPU& gpu) noexcept
 {
-    for (int i = 0; i < 2; i++)
+    for (GLuint fb : CompScreenOutputFB)
     {
         glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
-        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, CompScreenOutputFB[gpu.FrontBuffer]);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fb);
 
         glClear(GL_COLOR_BUFFER_BIT);
     }
@@ -246,7 +246,8 @@ void GLCompositor::Stop(const GPU& gpu) noexcept
 
 void GLCompositor::RenderFrame(const GPU& gpu, GLRenderer& renderer) noexcept
 {
-    int frontbuf = gpu.FrontBuffer;
+    // the presenter (the thread owning the GL context) composites the frame it holds
+    int frontbuf = gpu.GetPresentBuffer();
     glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
     glBindFramebuffer(GL_DRAW_FRAMEBUFFER, CompScreenOutputFB[frontbuf]);
 
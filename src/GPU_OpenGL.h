@@ -64,8 +64,8 @@ private:
     std::array<CompVertex, 2*3*2> CompVertices {};
 
     GLuint CompScreenInputTex = 0;
-    std::array<GLuint, 2> CompScreenOutputTex {};
-    std::array<GLuint, 2> CompScreenOutputFB {};
+    std::array<GLuint, 3> CompScreenOutputTex {};
+    std::array<GLuint, 3> CompScreenOutputFB {};
 };
 
 }
@@ -337,9 +337,11 @@ void NDS::SetupDirectBoot()
 
     // CHECKME: firmware seems to load this in 0x200 byte chunks
 
+    // read through the cart so any DLDI patch applied to the binary is included
     for (u32 i = arm9start; i < header.ARM9Size; i+=4)
     {
-        u32 tmp = *(u32*)&cartrom[header.ARM9ROMOffset+i];
+        u32 tmp = 0;
+        NDSCartSlot.GetCart()->ReadROM(header.ARM9ROMOffset+i, 4, (u8*)&tmp, 0);
         NDS::ARM9Write32(header.ARM9RAMAddress+i, tmp);
     }
 
@@ -578,7 +580,7 @@ void NDS::Stop(Platform::StopReason reason)
     SPU.Stop();
 }
 
-bool NDS::DoSavestate(Savestate* file)
+bool NDS::DoSavestate(Savestate* file, bool keepjit)
 {
     file->Section("NDSG");
 
@@ -715,7 +717,10 @@ bool NDS::DoSavestate(Savestate* file)
         Wifi.SetPowerCnt(PowerControl7 & 0x0002);
 
 #ifdef JIT_ENABLED
-        JIT.Reset();
+        if (keepjit)
+            JIT.InvalidateChangedCode();
+        else
+            JIT.Reset();
 #endif
     }
 
@@ -724,6 +729,23 @@ bool NDS::DoSavestate(Savestate* file)
     return true;
 }
 
+bool NDS::RollBackToSavestate(Savestate* file)
+{
+    if (file->Saving)
+        return false;
+
+#ifdef JIT_ENABLED
+    if (EnableJIT)
+        JIT.SnapshotCode();
+#endif
+
+    if (!DoSavestate(file, true))
+        return false;
+
+    GPU.RedoVBlankRendering();
+    return true;
+}
+
 void NDS::SetNDSCart(std::unique_ptr<NDSCart::CartCommon>&& cart)
 {
     NDSCartSlot.SetCart(std::move(cart));
@@ -1023,7 +1045,10 @@ u32 NDS::RunFrame()
             ARM7Timestamp-SysTimestamp,
             GPU.GPU3D.Timestamp-SysTimestamp);
 #endif
-        SPU.TransferOutput();
+        if (AudioOutputSuppressed)
+            SPU.DiscardOutput();
+        else
+            SPU.TransferOutput();
         break;
     }
 
@@ -1049,6 +1074,12 @@ u32 NDS::RunFrame()
         return RunFrame<false>();
 }
 
+void NDS::SetOutputSuppressed(bool video, bool audio) noexcept
+{
+    GPU.SuppressRendering = video;
+    AudioOutputSuppressed = audio;
+}
+
 void NDS::Reschedule(u64 target)
 {
     if (CurCPU == 0)
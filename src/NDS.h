@@ -311,7 +311,13 @@ public: // TODO: Encapsulate the rest of these members
     /// Stop the emulator.
     virtual void Stop(Platform::StopReason reason = Platform::StopReason::External);
 
-    bool DoSavestate(Savestate* file);
+    bool DoSavestate(Savestate* file) { return DoSavestate(file, false); }
+
+    /// Loads a savestate that this console saved at the end of a frame,
+    /// e.g. to roll back after running ahead. Unlike DoSavestate(), JIT blocks
+    /// are only invalidated where their code changed, and the rendering done
+    /// ahead of the next frame is redone, so the renderers are in sync again.
+    bool RollBackToSavestate(Savestate* file);
 
     void SetARM9RegionTimings(u32 addrstart, u32 addrend, u32 region, int buswidth, int nonseq, int seq);
     void SetARM7RegionTimings(u32 addrstart, u32 addrend, u32 region, int buswidth, int nonseq, int seq);
@@ -383,7 +389,14 @@ public: // TODO: Encapsulate the rest of these members
 
     u32 RunFrame();
 
+    /// Sets whether the upcoming frames produce video and audio output.
+    /// Meant for frames whose output is thrown away anyway (e.g. run-ahead);
+    /// the emulated state is not affected.
+    void SetOutputSuppressed(bool video, bool audio) noexcept;
+
     bool IsRunning() const noexcept { return Running; }
+    /// @return Whether the ARM9 has jumped to the inserted game's entry point since the last reset.
+    bool IsRunningGame() const noexcept { return RunningGame; }
 
     void TouchScreen(u16 x, u16 y);
     void ReleaseScreen();
@@ -499,6 +512,7 @@ private:
     u16 KeyCnt[2];
     bool Running;
     bool RunningGame;
+    bool AudioOutputSuppressed = false;
     u64 LastSysClockCycles;
     u64 FrameStartTimestamp;
     u64 NextTarget();
@@ -521,6 +535,7 @@ private:
     void EnterSleepMode();
     template <bool EnableJIT>
     u32 RunFrame();
+    bool DoSavestate(Savestate* file, bool keepjit);
 public:
     NDS(NDSArgs&& args) noexcept : NDS(std::move(args), 0) {}
     NDS() noexcept;
@@ -17,6 +17,7 @@
 */
 
 #include <string.h>
+#include <algorithm>
 #include "NDS.h"
 #include "DSi.h"
 #include "NDSCart.h"
@@ -178,7 +179,7 @@ CartCommon::CartCommon(const u8* rom, u32 len, u32 chipid, bool badDSiDump, ROML
 {
 }
 
-CartCommon::CartCommon(std::unique_ptr<u8[]>&& rom, u32 len, u32 chipid, bool badDSiDump, ROMListEntry romparams, melonDS::NDSCart::CartType type) :
+CartCommon::CartCommon(std::shared_ptr<const u8[]> rom, u32 len, u32 chipid, bool badDSiDump, ROMListEntry romparams, melonDS::NDSCart::CartType type) :
     ROM(std::move(rom)),
     ROMLength(len),
     ChipID(chipid),
@@ -192,6 +193,41 @@ CartCommon::CartCommon(std::unique_ptr<u8[]>&& rom, u32 len, u32 chipid, bool ba
 
 CartCommon::~CartCommon() = default;
 
+u8* CartCommon::GetWritableROM(u32 addr, u32 len)
+{
+    u32 start = addr;
+    u32 end = addr + len;
+    if (ROMOverlay)
+    {
+        start = std::min(start, ROMOverlayStart);
+        end = std::max(end, ROMOverlayStart + ROMOverlayLength);
+    }
+
+    if ((!ROMOverlay) || start != ROMOverlayStart || end != (ROMOverlayStart + ROMOverlayLength))
+    {
+        // grow the overlay to cover the requested range, keeping what was already modified
+        auto overlay = std::make_unique<u8[]>(end - start);
+        CopyROM(start, end - start, overlay.get());
+
+        ROMOverlay = std::move(overlay);
+        ROMOverlayStart = start;
+        ROMOverlayLength = end - start;
+    }
+
+    return &ROMOverlay[addr - ROMOverlayStart];
+}
+
+void CartCommon::CopyROM(u32 addr, u32 len, u8* data) const
+{
+    memcpy(data, ROM.get()+addr, len);
+    if (!ROMOverlay) return;
+
+    u32 start = std::max(addr, ROMOverlayStart);
+    u32 end = std::min(addr + len, ROMOverlayStart + ROMOverlayLength);
+    if (start < end)
+        memcpy(data + (start - addr), &ROMOverlay[start - ROMOverlayStart], end - start);
+}
+
 u32 CartCommon::Checksum() const
 {
     const NDSHeader& header = GetHeader();
@@ -360,7 +396,7 @@ void CartCommon::ReadROM(u32 addr, u32 len, u8* data, u32 offset) const
     if ((addr+len) > ROMLength)
         len = ROMLength - addr;
 
-    memcpy(data+offset, ROM.get()+addr, len);
+    CopyROM(addr, len, data+offset);
 }
 
 const NDSBanner* CartCommon::Banner() const
@@ -380,7 +416,7 @@ CartRetail::CartRetail(const u8* rom, u32 len, u32 chipid, bool badDSiDump, ROML
 {
 }
 
-CartRetail::CartRetail(std::unique_ptr<u8[]>&& rom, u32 len, u32 chipid, bool badDSiDump, ROMListEntry romparams, std::unique_ptr<u8[]>&& sram, u32 sramlen, melonDS::NDSCart::CartType type) :
+CartRetail::CartRetail(std::shared_ptr<const u8[]> rom, u32 len, u32 chipid, bool badDSiDump, ROMListEntry romparams, std::unique_ptr<u8[]>&& sram, u32 sramlen, melonDS::NDSCart::CartType type) :
     CartCommon(std::move(rom), len, chipid, badDSiDump, romparams, type)
 {
     u32 savememtype = ROMParams.SaveMemType <= 10 ? ROMParams.SaveMemType : 0;
@@ -558,7 +594,7 @@ void CartRetail::ReadROM_B7(u32 addr, u32 len, u8* data, u32 offset) const
             addr = 0x8000 + (addr & 0x1FF);
     }
 
-    memcpy(data+offset, ROM.get()+addr, len);
+    CopyROM(addr, len, data+offset);
 }
 
 u8 CartRetail::SRAMWrite_EEPROMTiny(u8 val, u32 pos, bool last)
@@ -837,7 +873,7 @@ CartRetailNAND::CartRetailNAND(const u8* rom, u32 len, u32 chipid, ROMListEntry
 {
 }
 
-CartRetailNAND::CartRetailNAND(std::unique_ptr<u8[]>&& rom, u32 len, u32 chipid, ROMListEntry romparams, std::unique_ptr<u8[]>&& sram, u32 sramlen) :
+CartRetailNAND::CartRetailNAND(std::shared_ptr<const u8[]> rom, u32 len, u32 chipid, ROMListEntry romparams, std::unique_ptr<u8[]>&& sram, u32 sramlen) :
     CartRetail(std::move(rom), len, chipid, false, romparams, std::move(sram), sramlen, CartType::RetailNAND)
 {
     BuildSRAMID();
@@ -1070,7 +1106,7 @@ CartRetailIR::CartRetailIR(const u8* rom, u32 len, u32 chipid, u32 irversion, bo
 }
 
 CartRetailIR::CartRetailIR(
-    std::unique_ptr<u8[]>&& rom,
+    std::shared_ptr<const u8[]> rom,
     u32 len,
     u32 chipid,
     u32 irversion,
@@ -1127,7 +1163,7 @@ CartRetailBT::CartRetailBT(const u8* rom, u32 len, u32 chipid, ROMListEntry romp
 {
 }
 
-CartRetailBT::CartRetailBT(std::unique_ptr<u8[]>&& rom, u32 len, u32 chipid, ROMListEntry romparams, std::unique_ptr<u8[]>&& sram, u32 sramlen) :
+CartRetailBT::CartRetailBT(std::shared_ptr<const u8[]> rom, u32 len, u32 chipid, ROMListEntry romparams, std::unique_ptr<u8[]>&& sram, u32 sramlen) :
     CartRetail(std::move(rom), len, chipid, false, romparams, std::move(sram), sramlen, CartType::RetailBT)
 {
     Log(LogLevel::Info,"POKETYPE CART\n");
@@ -1154,7 +1190,7 @@ CartSD::CartSD(const u8* rom, u32 len, u32 chipid, ROMListEntry romparams, std::
     CartSD(CopyToUnique(rom, len), len, chipid, romparams, std::move(sdcard))
 {}
 
-CartSD::CartSD(std::unique_ptr<u8[]>&& rom, u32 len, u32 chipid, ROMListEntry romparams, std::optional<FATStorage>&& sdcard) :
+CartSD::CartSD(std::shared_ptr<const u8[]> rom, u32 len, u32 chipid, ROMListEntry romparams, std::optional<FATStorage>&& sdcard) :
     CartCommon(std::move(rom), len, chipid, false, romparams, CartType::Homebrew),
     SD(std::move(sdcard))
 {
@@ -1280,7 +1316,7 @@ void CartSD::ApplyDLDIPatch(const u8* patch, u32 patchlen, bool readonly)
     u32 offset = *(u32*)&ROM[0x20];
     u32 size = *(u32*)&ROM[0x2C];
 
-    u8* binary = &ROM[offset];
+    const u8* binary = &ROM[offset];
 
     for (u32 i = 0; i < size; )
     {
@@ -1289,7 +1325,16 @@ void CartSD::ApplyDLDIPatch(const u8* patch, u32 patchlen, bool readonly)
             *(u32*)&binary[i+8] == 0x006D6873)
         {
             Log(LogLevel::Debug, "DLDI structure found at %08X (%08X)\n", i, offset+i);
-            ApplyDLDIPatchAt(binary, i, patch, patchlen, readonly);
+
+            // the patch can fill the space allocated to the existing driver
+            u32 drvlen = std::max(1u << std::min<u8>(binary[i+0x0F], 31), patchlen);
+            if (drvlen > ROMLength - (offset+i))
+            {
+                Log(LogLevel::Error, "DLDI driver space goes past the end of the ROM\n");
+                return;
+            }
+
+            ApplyDLDIPatchAt(GetWritableROM(offset+i, drvlen), 0, patch, patchlen, readonly);
             i += patchlen;
         }
         else
@@ -1303,14 +1348,14 @@ void CartSD::ReadROM_B7(u32 addr, u32 len, u8* data, u32 offset) const
 
     addr &= (ROMLength-1);
 
-    memcpy(data+offset, ROM.get()+addr, len);
+    CopyROM(addr, len, data+offset);
 }
 
 CartHomebrew::CartHomebrew(const u8* rom, u32 len, u32 chipid, ROMListEntry romparams, std::optional<FATStorage>&& sdcard) :
     CartSD(rom, len, chipid, romparams, std::move(sdcard))
 {}
 
-CartHomebrew::CartHomebrew(std::unique_ptr<u8[]>&& rom, u32 len, u32 chipid, ROMListEntry romparams, std::optional<FATStorage>&& sdcard) :
+CartHomebrew::CartHomebrew(std::shared_ptr<const u8[]> rom, u32 len, u32 chipid, ROMListEntry romparams, std::optional<FATStorage>&& sdcard) :
     CartSD(std::move(rom), len, chipid, romparams, std::move(sdcard))
 {}
 
@@ -1537,12 +1582,10 @@ bool ReadROMParams(u32 gamecode, ROMListEntry* params)
 void NDSCartSlot::DecryptSecureArea(u8* out) noexcept
 {
     const NDSHeader& header = Cart->GetHeader();
-    const u8* cartrom = Cart->GetROM();
-
     u32 gamecode = header.GameCodeAsU32();
     u32 arm9base = header.ARM9ROMOffset;
 
-    memcpy(out, &cartrom[arm9base], 0x800);
+    Cart->ReadROM(arm9base, 0x800, out, 0);
 
     Key1_InitKeycode(false, gamecode, 2, 2, NDS.GetARM7BIOS().data(), ARM7BIOSSize);
     Key1_Decrypt((u32*)&out[0]);
@@ -1570,6 +1613,8 @@ std::unique_ptr<CartCommon> ParseROM(const u8* romdata, u32 romlen, std::optiona
     return ParseROM(CopyToUnique(romdata, romlen), romlen, std::move(args));
 }
 
+static std::unique_ptr<CartCommon> CreateCart(std::shared_ptr<const u8[]>&& cartrom, u32 cartromsize, u32 romlen, std::optional<NDSCartArgs>&& args);
+
 std::unique_ptr<CartCommon> ParseROM(std::unique_ptr<u8[]>&& romdata, u32 romlen, std::optional<NDSCartArgs>&& args)
 {
     if (romdata == nullptr)
@@ -1586,6 +1631,33 @@ std::unique_ptr<CartCommon> ParseROM(std::unique_ptr<u8[]>&& romdata, u32 romlen
 
     auto [cartrom, cartromsize] = PadToPowerOf2(std::move(romdata), romlen);
 
+    return CreateCart(std::move(cartrom), cartromsize, romlen, std::move(args));
+}
+
+std::unique_ptr<CartCommon> ParseROM(std::shared_ptr<const u8[]> romdata, u32 romlen, std::optional<NDSCartArgs>&& args)
+{
+    if (romdata == nullptr)
+    {
+        Log(LogLevel::Error, "NDSCart: romdata is null\n");
+        return nullptr;
+    }
+
+    if (romlen == 0)
+    {
+        Log(LogLevel::Error, "NDSCart: romlen is zero\n");
+        return nullptr;
+    }
+
+    if ((romlen & (romlen - 1)) == 0)
+        return CreateCart(std::move(romdata), romlen, romlen, std::move(args));
+
+    // the cart needs a power-of-two sized image, so this one can't be shared as-is
+    auto [cartrom, cartromsize] = PadToPowerOf2(romdata.get(), romlen);
+    return CreateCart(std::move(cartrom), cartromsize, romlen, std::move(args));
+}
+
+static std::unique_ptr<CartCommon> CreateCart(std::shared_ptr<const u8[]>&& cartrom, u32 cartromsize, u32 romlen, std::optional<NDSCartArgs>&& args)
+{
     NDSHeader header {};
     memcpy(&header, cartrom.get(), sizeof(header));
 
@@ -1696,22 +1768,25 @@ void NDSCartSlot::SetCart(std::unique_ptr<CartCommon>&& cart) noexcept
 
     const NDSHeader& header = Cart->GetHeader();
     const ROMListEntry romparams = Cart->GetROMParams();
-    const u8* cartrom = Cart->GetROM();
     if (header.ARM9ROMOffset >= 0x4000 && header.ARM9ROMOffset < 0x8000)
     {
         // reencrypt secure area if needed
-        if (*(u32*)&cartrom[header.ARM9ROMOffset] == 0xE7FFDEFF && *(u32*)&cartrom[header.ARM9ROMOffset + 0x10] != 0xE7FFDEFF)
+        // (read through the overlay, it's already encrypted there if the cart was inserted before)
+        u32 securestart[5] {};
+        Cart->ReadROM(header.ARM9ROMOffset, sizeof(securestart), (u8*)securestart, 0);
+        if (securestart[0] == 0xE7FFDEFF && securestart[4] != 0xE7FFDEFF)
         {
             Log(LogLevel::Debug, "Re-encrypting cart secure area\n");
 
-            strncpy((char*)&cartrom[header.ARM9ROMOffset], "encryObj", 8);
+            u8* securearea = Cart->GetWritableROM(header.ARM9ROMOffset, 0x800);
+            strncpy((char*)securearea, "encryObj", 8);
 
             Key1_InitKeycode(false, romparams.GameCode, 3, 2, NDS.GetARM7BIOS().data(), ARM7BIOSSize);
             for (u32 i = 0; i < 0x800; i += 8)
-                Key1_Encrypt((u32*)&cartrom[header.ARM9ROMOffset + i]);
+                Key1_Encrypt((u32*)&securearea[i]);
 
             Key1_InitKeycode(false, romparams.GameCode, 2, 2, NDS.GetARM7BIOS().data(), ARM7BIOSSize);
-            Key1_Encrypt((u32*)&cartrom[header.ARM9ROMOffset]);
+            Key1_Encrypt((u32*)&securearea[0]);
 
             Log(LogLevel::Debug, "Re-encrypted cart secure area\n");
         }
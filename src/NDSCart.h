@@ -77,7 +77,7 @@ class CartCommon
 {
 public:
     CartCommon(const u8* rom, u32 len, u32 chipid, bool badDSiDump, ROMListEntry romparams, CartType type);
-    CartCommon(std::unique_ptr<u8[]>&& rom, u32 len, u32 chipid, bool badDSiDump, ROMListEntry romparams, CartType type);
+    CartCommon(std::shared_ptr<const u8[]> rom, u32 len, u32 chipid, bool badDSiDump, ROMListEntry romparams, CartType type);
     virtual ~CartCommon();
 
     [[nodiscard]] u32 Type() const { return CartType; };
@@ -106,13 +106,35 @@ public:
     [[nodiscard]] const NDSBanner* Banner() const;
     [[nodiscard]] const ROMListEntry& GetROMParams() const { return ROMParams; };
     [[nodiscard]] u32 ID() const { return ChipID; }
+    /// @return The ROM image as it was loaded.
+    /// Doesn't include changes made through \c GetWritableROM;
+    /// use \c ReadROM to see the data as the console would.
     [[nodiscard]] const u8* GetROM() const { return ROM.get(); }
     [[nodiscard]] u32 GetROMLength() const { return ROMLength; }
-protected:
+
+    /// @return The ROM image backing this cart.
+    /// It can be passed to \c ParseROM to create carts for other emulator instances
+    /// that share the same memory instead of each holding their own copy.
+    [[nodiscard]] std::shared_ptr<const u8[]> GetSharedROM() const { return ROM; }
+
+    /// @return A pointer to ROM data in the range [addr, addr+len) that may be modified.
+    /// The ROM image itself is never written to (it may be shared, or memory-mapped from a file),
+    /// so the modified range is kept in a small per-cart overlay instead.
+    [[nodiscard]] u8* GetWritableROM(u32 addr, u32 len);
+
+    /// Copies ROM data, including any changes made through \c GetWritableROM.
+    /// Reads past the end of the ROM are ignored.
     void ReadROM(u32 addr, u32 len, u8* data, u32 offset) const;
+protected:
+    void CopyROM(u32 addr, u32 len, u8* data) const;
 
-    std::unique_ptr<u8[]> ROM = nullptr;
+    std::shared_ptr<const u8[]> ROM = nullptr;
     u32 ROMLength = 0;
+    // modified copy of the part of the ROM written through GetWritableROM
+    // (re-encrypted secure area, DLDI driver)
+    std::unique_ptr<u8[]> ROMOverlay = nullptr;
+    u32 ROMOverlayStart = 0;
+    u32 ROMOverlayLength = 0;
     u32 ChipID = 0;
     bool IsDSi = false;
     bool DSiMode = false;
@@ -142,7 +164,7 @@ public:
         melonDS::NDSCart::CartType type = CartType::Retail
     );
     CartRetail(
-        std::unique_ptr<u8[]>&& rom,
+        std::shared_ptr<const u8[]> rom,
         u32 len, u32 chipid,
         bool badDSiDump,
         ROMListEntry romparams,
@@ -188,7 +210,7 @@ class CartRetailNAND : public CartRetail
 {
 public:
     CartRetailNAND(const u8* rom, u32 len, u32 chipid, ROMListEntry romparams, std::unique_ptr<u8[]>&& sram, u32 sramlen);
-    CartRetailNAND(std::unique_ptr<u8[]>&& rom, u32 len, u32 chipid, ROMListEntry romparams, std::unique_ptr<u8[]>&& sram, u32 sramlen);
+    CartRetailNAND(std::shared_ptr<const u8[]> rom, u32 len, u32 chipid, ROMListEntry romparams, std::unique_ptr<u8[]>&& sram, u32 sramlen);
     ~CartRetailNAND() override;
 
     void Reset() override;
@@ -217,7 +239,7 @@ class CartRetailIR : public CartRetail
 {
 public:
     CartRetailIR(const u8* rom, u32 len, u32 chipid, u32 irversion, bool badDSiDump, ROMListEntry romparams, std::unique_ptr<u8[]>&& sram, u32 sramlen);
-    CartRetailIR(std::unique_ptr<u8[]>&& rom, u32 len, u32 chipid, u32 irversion, bool badDSiDump, ROMListEntry romparams, std::unique_ptr<u8[]>&& sram, u32 sramlen);
+    CartRetailIR(std::shared_ptr<const u8[]> rom, u32 len, u32 chipid, u32 irversion, bool badDSiDump, ROMListEntry romparams, std::unique_ptr<u8[]>&& sram, u32 sramlen);
     ~CartRetailIR() override;
 
     void Reset() override;
@@ -236,7 +258,7 @@ class CartRetailBT : public CartRetail
 {
 public:
     CartRetailBT(const u8* rom, u32 len, u32 chipid, ROMListEntry romparams, std::unique_ptr<u8[]>&& sram, u32 sramlen);
-    CartRetailBT(std::unique_ptr<u8[]>&& rom, u32 len, u32 chipid, ROMListEntry romparams, std::unique_ptr<u8[]>&& sram, u32 sramlen);
+    CartRetailBT(std::shared_ptr<const u8[]> rom, u32 len, u32 chipid, ROMListEntry romparams, std::unique_ptr<u8[]>&& sram, u32 sramlen);
     ~CartRetailBT() override;
 
     u8 SPIWrite(u8 val, u32 pos, bool last) override;
@@ -247,7 +269,7 @@ class CartSD : public CartCommon
 {
 public:
     CartSD(const u8* rom, u32 len, u32 chipid, ROMListEntry romparams, std::optional<FATStorage>&& sdcard = std::nullopt);
-    CartSD(std::unique_ptr<u8[]>&& rom, u32 len, u32 chipid, ROMListEntry romparams, std::optional<FATStorage>&& sdcard = std::nullopt);
+    CartSD(std::shared_ptr<const u8[]> rom, u32 len, u32 chipid, ROMListEntry romparams, std::optional<FATStorage>&& sdcard = std::nullopt);
     ~CartSD() override;
 
     [[nodiscard]] const std::optional<FATStorage>& GetSDCard() const noexcept { return SD; }
@@ -289,7 +311,7 @@ class CartHomebrew : public CartSD
 {
 public:
     CartHomebrew(const u8* rom, u32 len, u32 chipid, ROMListEntry romparams, std::optional<FATStorage>&& sdcard = std::nullopt);
-    CartHomebrew(std::unique_ptr<u8[]>&& rom, u32 len, u32 chipid, ROMListEntry romparams, std::optional<FATStorage>&& sdcard = std::nullopt);
+    CartHomebrew(std::shared_ptr<const u8[]> rom, u32 len, u32 chipid, ROMListEntry romparams, std::optional<FATStorage>&& sdcard = std::nullopt);
     ~CartHomebrew() override;
 
     void Reset() override;
@@ -322,7 +344,7 @@ enum CartR4Language
 class CartR4 : public CartSD
 {
 public:
-    CartR4(std::unique_ptr<u8[]>&& rom, u32 len, u32 chipid, ROMListEntry romparams, CartR4Type ctype, CartR4Language clanguage,
+    CartR4(std::shared_ptr<const u8[]> rom, u32 len, u32 chipid, ROMListEntry romparams, CartR4Type ctype, CartR4Language clanguage,
         std::optional<FATStorage>&& sdcard = std::nullopt);
     ~CartR4() override;
 
@@ -463,6 +485,14 @@ private:
 /// or \c nullptr if the ROM data couldn't be parsed.
 std::unique_ptr<CartCommon> ParseROM(const u8* romdata, u32 romlen, std::optional<NDSCartArgs>&& args = std::nullopt);
 std::unique_ptr<CartCommon> ParseROM(std::unique_ptr<u8[]>&& romdata, u32 romlen, std::optional<NDSCartArgs>&& args = std::nullopt);
+
+/// Parses a ROM image that may be shared with other carts,
+/// e.g. one obtained from \c CartCommon::GetSharedROM.
+/// The data is never written to, and is not copied unless \c romlen isn't a power of two,
+/// so it may also be a read-only memory-mapped file.
+/// Several emulator instances can then run the same game without each
+/// keeping their own copy of the ROM in memory.
+std::unique_ptr<CartCommon> ParseROM(std::shared_ptr<const u8[]> romdata, u32 romlen, std::optional<NDSCartArgs>&& args = std::nullopt);
 }
 
 #endif
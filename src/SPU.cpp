@@ -928,6 +928,13 @@ void SPU::TransferOutput()
     Platform::Mutex_Unlock(AudioLock);;
 }
 
+void SPU::DiscardOutput()
+{
+    // drop the samples mixed during this frame instead of queueing them
+    // the backbuffer is only touched by the emulation thread, no need to lock
+    OutputBackbufferWritePosition = 0;
+}
+
 void SPU::TrimOutput()
 {
     Platform::Mutex_Lock(AudioLock);
@@ -241,6 +241,7 @@ public:
     void Sync(bool wait);
     int ReadOutput(s16* data, int samples);
     void TransferOutput();
+    void DiscardOutput();
 
     u8 Read8(u32 addr);
     u16 Read16(u32 addr);
@@ -253,8 +253,12 @@ void Savestate::VarArray(void* data, u32 len)
 void Savestate::Finish()
 {
     if (Error || finished) return;
-    CloseCurrentSection();
-    WriteStateLength();
+    if (Saving)
+    {
+        // when loading, the buffer may be reused afterwards, so don't touch the header
+        CloseCurrentSection();
+        WriteStateLength();
+    }
     finished = true;
 }
 
@@ -266,6 +270,9 @@ void Savestate::Rewind(bool save)
 
     buffer_offset = 0;
     finished = false;
+
+    if (Saving)
+        WriteSavestateHeader();
 }
 
 void Savestate::CloseCurrentSection()
@@ -349,7 +356,13 @@ u32 Savestate::FindSection(const char* magic) const
     // Start looking at the savestate's beginning, right after its global header
     // (we can't start from the current offset because then we'd lose the ability to rearrange sections)
 
-    for (u32 offset = 0x10; offset < buffer_length;)
+    // Don't look past the end of the state itself, the rest of the buffer
+    // may hold stale data if it's being reused
+    u32 state_length = buffer_length;
+    memcpy(&state_length, buffer + 0x08, sizeof(state_length));
+    if (state_length > buffer_length) state_length = buffer_length;
+
+    for (u32 offset = 0x10; offset < state_length;)
     { // Until we've found the desired section...
 
         // Get this section's magic number
@@ -364,7 +377,7 @@ u32 Savestate::FindSection(const char* magic) const
         // Haven't found our section yet. Let's move on to the next one.
 
         u32 section_length_offset = offset + sizeof(read_magic);
-        if (section_length_offset >= buffer_length)
+        if (section_length_offset >= state_length)
         { // If trying to read the section length would take us past the file's end...
             break;
         }
@@ -372,6 +385,10 @@ u32 Savestate::FindSection(const char* magic) const
         // First we need to find out how big this section is...
         u32 section_length = 0;
         memcpy(&section_length, buffer + section_length_offset, sizeof(section_length));
+        if (section_length == 0)
+        { // A zero-length section means the state is corrupt, and we'd never get past it
+            break;
+        }
 
         // ...then skip it. (The section length includes the 16-byte header.)
         offset += section_length;
@@ -72,7 +72,9 @@ public:
 
     void Finish();
 
-    // TODO rewinds the stream
+    /// Rewinds the stream so the same buffer can be reused for another
+    /// save or load, without reallocating it.
+    /// When saving, the header is rewritten and any previous contents are overwritten.
     void Rewind(bool save);
 
     bool IsAtLeastVersion(u32 major, u32 minor)
@@ -16,6 +16,12 @@
     with melonDS. If not, see http://www.gnu.org/licenses/.
 */
 
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+
 #include "ArchiveUtil.h"
 #include "Platform.h"
 
@@ -157,6 +163,106 @@ s32 ExtractFileFromArchive(QString path, QString wantedFile, std::unique_ptr<u8[
 
 }
 
+static void TrimCache(QDir& cache, qint64 maxSize, const QString& keep)
+{
+    // cached files are named after their 40-character SHA-1 key;
+    // anything else is an extraction still in progress
+    QFileInfoList files = cache.entryInfoList(QDir::Files, QDir::Time);
+    qint64 total = 0;
+
+    for (const QFileInfo& file : files)
+    {
+        if (file.fileName().length() != 40)
+            continue;
+
+        total += file.size();
+        if (total > maxSize && file.absoluteFilePath() != keep)
+        {
+            Log(LogLevel::Debug, "Removing %s from the archive cache\n", file.fileName().toUtf8().constData());
+            total -= file.size();
+            QFile::remove(file.absoluteFilePath());
+        }
+    }
+}
+
+QString ExtractFileToCache(QString path, QString wantedFile, qint64 maxSize)
+{
+    QFileInfo archiveInfo(path);
+    if (!archiveInfo.exists())
+        return "";
+
+    QCryptographicHash key(QCryptographicHash::Sha1);
+    key.addData(archiveInfo.absoluteFilePath().toUtf8());
+    key.addData(QByteArray::number(archiveInfo.size()));
+    key.addData(QByteArray::number(archiveInfo.lastModified().toMSecsSinceEpoch()));
+    key.addData(wantedFile.toUtf8());
+
+    QDir cache(QStandardPaths::writableLocation(QStandardPaths::CacheLocation));
+    if (!cache.mkpath("extracted") || !cache.cd("extracted"))
+        return "";
+
+    QString cachedFile = cache.absoluteFilePath(QString::fromLatin1(key.result().toHex()));
+    if (QFileInfo::exists(cachedFile))
+    {
+        // touch the file so it counts as recently used
+        QFile file(cachedFile);
+        if (file.open(QIODevice::ReadWrite))
+            file.setFileTime(QDateTime::currentDateTime(), QFileDevice::FileModificationTime);
+
+        return cachedFile;
+    }
+
+    struct archive *a = archive_read_new();
+    struct archive_entry *entry;
+    bool found = false;
+
+    archive_read_support_format_all(a);
+    archive_read_support_filter_all(a);
+
+    if (melon_archive_open(a, path, 10240) == ARCHIVE_OK)
+    {
+        while (archive_read_next_header(a, &entry) == ARCHIVE_OK)
+        {
+            if (strcmp(wantedFile.toUtf8().constData(), archive_entry_pathname_utf8(entry)) == 0)
+            {
+                found = true;
+                break;
+            }
+        }
+    }
+
+    // stream the data straight to disk; QSaveFile only moves it into place
+    // once it's complete, so a failed extraction never leaves a truncated file
+    bool ok = false;
+    QSaveFile out(cachedFile);
+    if (found && out.open(QIODevice::WriteOnly))
+    {
+        const size_t bufferSize = 0x10000;
+        std::unique_ptr<char[]> buffer = std::make_unique<char[]>(bufferSize);
+        ssize_t len;
+
+        while ((len = archive_read_data(a, buffer.get(), bufferSize)) > 0)
+        {
+            if (out.write(buffer.get(), len) != len)
+                break;
+        }
+
+        if (len < 0)
+            Log(LogLevel::Error, "Error whilst extracting from archive: %s\n", archive_error_string(a));
+
+        ok = (len == 0) && out.commit();
+    }
+
+    archive_read_close(a);
+    archive_read_free(a);
+
+    if (!ok)
+        return "";
+
+    TrimCache(cache, maxSize, cachedFile);
+    return cachedFile;
+}
+
 /*u32 ExtractFileFromArchive(const char* path, const char* wantedFile, u8 **romdata)
 {
     QByteArray romBuffer;
@@ -38,6 +38,13 @@ namespace Archive
 using namespace melonDS;
 QVector<QString> ListArchive(QString path);
 s32 ExtractFileFromArchive(QString path, QString wantedFile, std::unique_ptr<u8[]>& filedata, u32* filesize);
+
+// Extracts a file from an archive into the on-disk cache, unless it's already there,
+// and returns the path to the extracted file (or an empty string on failure).
+// Cached files are keyed by the archive's path, size and modification time
+// and by the entry name. The least recently used ones are removed to keep
+// the cache under maxSize bytes.
+QString ExtractFileToCache(QString path, QString wantedFile, qint64 maxSize);
 //QVector<QString> ExtractFileFromArchive(QString path, QString wantedFile, QByteArray *romBuffer);
 //u32 ExtractFileFromArchive(const char* path, const char* wantedFile, u8 **romdata);
 
@@ -56,6 +56,7 @@ int ScreenVSyncInterval;
 
 int _3DRenderer;
 bool Threaded3D;
+bool Threaded2D;
 
 int GL_ScaleFactor;
 bool GL_BetterPolygons;
@@ -63,9 +64,11 @@ bool GL_BetterPolygons;
 bool LimitFPS;
 bool AudioSync;
 bool ShowOSD;
+int RunAheadFrames;
 
 int ConsoleType;
 bool DirectBoot;
+bool BootSnapshotCache;
 
 #ifdef JIT_ENABLED
 bool JIT_Enable = false;
@@ -134,6 +137,7 @@ std::string RecentROMList[10];
 std::string SaveFilePath;
 std::string SavestatePath;
 std::string CheatFilePath;
+int ArchiveCacheSize;
 
 bool EnableCheats;
 
@@ -246,6 +250,7 @@ ConfigEntry ConfigFile[] =
 
     {"3DRenderer", 0, &_3DRenderer, 0, false},
     {"Threaded3D", 1, &Threaded3D, true, false},
+    {"Threaded2D", 1, &Threaded2D, false, false},
 
     {"GL_ScaleFactor", 0, &GL_ScaleFactor, 1, false},
     {"GL_BetterPolygons", 1, &GL_BetterPolygons, false, false},
@@ -253,9 +258,11 @@ ConfigEntry ConfigFile[] =
     {"LimitFPS", 1, &LimitFPS, true, false},
     {"AudioSync", 1, &AudioSync, false},
     {"ShowOSD", 1, &ShowOSD, true, false},
+    {"RunAheadFrames", 0, &RunAheadFrames, 0, false},
 
     {"ConsoleType", 0, &ConsoleType, 0, false},
     {"DirectBoot", 1, &DirectBoot, true, false},
+    {"BootSnapshotCache", 1, &BootSnapshotCache, false, false},
 
 #ifdef JIT_ENABLED
     {"JIT_Enable", 1, &JIT_Enable, false, false},
@@ -336,6 +343,7 @@ ConfigEntry ConfigFile[] =
     {"SaveFilePath", 2, &SaveFilePath, (std::string)"", true},
     {"SavestatePath", 2, &SavestatePath, (std::string)"", true},
     {"CheatFilePath", 2, &CheatFilePath, (std::string)"", true},
+    {"ArchiveCacheSize", 0, &ArchiveCacheSize, 2048, false}, // in MB, 0 disables the cache
 
     {"EnableCheats", 1, &EnableCheats, false, true},
 
@@ -100,6 +100,7 @@ extern int ScreenVSyncInterval;
 
 extern int _3DRenderer;
 extern bool Threaded3D;
+extern bool Threaded2D;
 
 extern int GL_ScaleFactor;
 extern bool GL_BetterPolygons;
@@ -107,9 +108,11 @@ extern bool GL_BetterPolygons;
 extern bool LimitFPS;
 extern bool AudioSync;
 extern bool ShowOSD;
+extern int RunAheadFrames;
 
 extern int ConsoleType;
 extern bool DirectBoot;
+extern bool BootSnapshotCache;
 
 #ifdef JIT_ENABLED
 extern bool JIT_Enable;
@@ -178,6 +181,7 @@ extern std::string RecentROMList[10];
 extern std::string SaveFilePath;
 extern std::string SavestatePath;
 extern std::string CheatFilePath;
+extern int ArchiveCacheSize;
 
 extern bool EnableCheats;
 
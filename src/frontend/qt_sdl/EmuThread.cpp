@@ -50,6 +50,7 @@
 #include "RTC.h"
 #include "DSi.h"
 #include "DSi_I2C.h"
+#include "GPU2D_Soft.h"
 #include "GPU3D_Soft.h"
 #include "GPU3D_OpenGL.h"
 
@@ -326,6 +327,8 @@ void EmuThread::run()
         videoRenderer = 0;
     }
 
+    NDS->GPU.SetRenderer2D(std::make_unique<GPU2D::SoftRenderer>(NDS->GPU, Config::Threaded2D));
+
     if (videoRenderer == 0)
     { // If we're using the software renderer...
         NDS->GPU.SetRenderer3D(std::make_unique<SoftRenderer>(Config::Threaded3D != 0));
@@ -455,6 +458,8 @@ void EmuThread::run()
 
                 videoSettingsDirty = false;
 
+                NDS->GPU.SetRenderer2D(std::make_unique<GPU2D::SoftRenderer>(NDS->GPU, Config::Threaded2D));
+
                 if (videoRenderer == 0)
                 { // If we're using the software renderer...
                     NDS->GPU.SetRenderer3D(std::make_unique<SoftRenderer>(Config::Threaded3D != 0));
@@ -512,7 +517,13 @@ void EmuThread::run()
 
 
             // emulate
-            u32 nlines = NDS->RunFrame();
+            u32 nlines;
+            if (Config::RunAheadFrames > 0)
+                nlines = runFrameAhead(Config::RunAheadFrames);
+            else
+                nlines = NDS->RunFrame();
+
+            ROMManager::UpdateBootSnapshot(*NDS);
 
             if (ROMManager::NDSSave)
                 ROMManager::NDSSave->CheckFlush();
@@ -523,16 +534,19 @@ void EmuThread::run()
             if (ROMManager::FirmwareSave)
                 ROMManager::FirmwareSave->CheckFlush();
 
-            if (!screenGL)
-            {
-                FrontBufferLock.lock();
-                FrontBuffer = NDS->GPU.FrontBuffer;
-                FrontBufferLock.unlock();
-            }
-            else
+            // without OpenGL, the screen widget picks up the newest frame by itself
+            // with it, this thread is the presenter. Accelerated frames only get composited
+            // at the next VBlank, so those are taken after drawing the one composited now
+            if (screenGL)
             {
-                FrontBuffer = NDS->GPU.FrontBuffer;
+                bool composited = NDS->GPU.GetRenderer3D().Accelerated;
+                if (!composited)
+                    NDS->GPU.AcquireFrontBuffer();
+
                 screenGL->drawScreenGL();
+
+                if (composited)
+                    NDS->GPU.AcquireFrontBuffer();
             }
 
 #ifdef MELONCAP
@@ -618,6 +632,14 @@ void EmuThread::run()
                     sprintf(melontitle, "[%d/%.0f] melonDS " MELONDS_VERSION, fps, fpstarget);
                 else
                     sprintf(melontitle, "[%d/%.0f] melonDS (%d)", fps, fpstarget, inst+1);
+
+                // report what run-ahead costs per frame, so the user can pick a sensible amount
+                if (Config::RunAheadFrames > 0)
+                {
+                    int len = strlen(melontitle);
+                    snprintf(&melontitle[len], sizeof(melontitle) - len, " [run-ahead %d: +%.2f ms]",
+                             Config::RunAheadFrames, runAheadOverhead * 1000.0);
+                }
                 changeWindowTitle(melontitle);
             }
         }
@@ -675,6 +697,50 @@ void EmuThread::run()
     // nds is out of scope, so unique_ptr cleans it up for us
 }
 
+u32 EmuThread::runFrameAhead(int frames)
+{
+    double perfCountsSec = 1.0 / SDL_GetPerformanceFrequency();
+
+    // the real frame: this is the one emulation actually moves forward by,
+    // its audio is kept but its video will be replaced by the last frame ahead
+    NDS->SetOutputSuppressed(true, false);
+    u32 nlines = NDS->RunFrame();
+    NDS->SetOutputSuppressed(false, false);
+
+    double start = SDL_GetPerformanceCounter() * perfCountsSec;
+
+    // the buffer is allocated once and reused for every frame
+    if (!runAheadState)
+        runAheadState = std::make_unique<Savestate>();
+    else
+        runAheadState->Rewind(true);
+
+    if (runAheadState->Error || !NDS->DoSavestate(runAheadState.get()) || runAheadState->Error)
+    {
+        // no snapshot, no run-ahead; the presenter keeps showing the previous frame
+        // this once, as the real one wasn't drawn
+        runAheadState = nullptr;
+        return nlines;
+    }
+
+    for (int i = 0; i < frames; i++)
+    {
+        // only the last frame ahead gets rendered, none of them are heard
+        NDS->SetOutputSuppressed(i < (frames-1), true);
+        NDS->RunFrame();
+    }
+    NDS->SetOutputSuppressed(false, false);
+
+    runAheadState->Rewind(false);
+    NDS->RollBackToSavestate(runAheadState.get());
+
+    // smoothed, it's only there to give an idea
+    double overhead = (SDL_GetPerformanceCounter() * perfCountsSec) - start;
+    runAheadOverhead += (overhead - runAheadOverhead) * 0.1;
+
+    return nlines;
+}
+
 void EmuThread::changeWindowTitle(char* title)
 {
     emit windowTitleChange(QString(title));
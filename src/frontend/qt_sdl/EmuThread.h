@@ -35,6 +35,7 @@ using UpdateConsoleGBAArgs = std::variant<Keep, std::unique_ptr<melonDS::GBACart
 namespace melonDS
 {
 class NDS;
+class Savestate;
 }
 
 class ScreenPanelGL;
@@ -62,9 +63,6 @@ public:
     void initContext();
     void deinitContext();
 
-    int FrontBuffer = 0;
-    QMutex FrontBufferLock;
-
     /// Applies the config in args.
     /// Creates a new NDS console if needed,
     /// modifies the existing one if possible.
@@ -99,6 +97,10 @@ private:
         std::unique_ptr<melonDS::GBACart::CartCommon>&& gbacart
     ) noexcept;
 
+    // runs one frame, then runs ahead of it and rolls back
+    // so that the presented frame reflects the input sooner
+    melonDS::u32 runFrameAhead(int frames);
+
     enum EmuStatusKind
     {
         emuStatus_Exit,
@@ -129,6 +131,9 @@ private:
 
     int videoRenderer;
     bool videoSettingsDirty;
+
+    std::unique_ptr<melonDS::Savestate> runAheadState;
+    double runAheadOverhead = 0.0;
 };
 
 #endif // EMUTHREAD_H
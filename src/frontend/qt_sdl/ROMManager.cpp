@@ -29,6 +29,9 @@
 #include <fstream>
 
 #include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QStandardPaths>
 
 #include <zstd.h>
 #ifdef ARCHIVE_SUPPORT_ENABLED
@@ -44,6 +47,8 @@
 #include "RTC.h"
 #include "DSi_I2C.h"
 #include "FreeBIOS.h"
+#include "CRC32.h"
+#include "Utils.h"
 #include "main.h"
 
 using std::make_unique;
@@ -76,6 +81,11 @@ std::unique_ptr<Savestate> BackupState = nullptr;
 bool SavestateLoaded = false;
 std::string PreviousSaveFile = "";
 
+// path of the boot snapshot to take once the game is booted, if any
+std::string PendingBootSnapshot = "";
+// state at the end of the last frame, the snapshot if the game starts in the next one
+std::unique_ptr<Savestate> BootSnapshotState = nullptr;
+
 ARCodeFile* CheatFile = nullptr;
 bool CheatsOn = false;
 
@@ -409,6 +419,7 @@ bool LoadState(NDS& nds, const std::string& filename)
     }
 
     SavestateLoaded = true;
+    PendingBootSnapshot = "";
 
     return true;
 }
@@ -848,8 +859,144 @@ void SetDateTime(NDS& nds)
                           time.time().hour(), time.time().minute(), time.time().second());
 }
 
+// Snapshots are keyed by everything the state after boot depends on:
+// the cart and the GBA slot cart, the BIOS and firmware (which includes
+// the firmware settings) and the savestate format.
+// Changing any of those results in a new snapshot.
+std::string GetBootSnapshotPath(const NDS& nds)
+{
+    // DSi boots also depend on the NAND, which isn't part of savestates
+    if (nds.ConsoleType != 0) return "";
+
+    // homebrew may depend on the contents of its SD card
+    const NDSCart::CartCommon* cart = nds.GetNDSCart();
+    if (!cart || cart->GetHeader().IsHomebrew()) return "";
+
+    u32 romkey = CRC32(cart->GetROM(), sizeof(NDSHeader));
+    u32 checksum = cart->Checksum();
+    u32 romlen = cart->GetROMLength();
+    romkey = CRC32((const u8*)&checksum, sizeof(checksum), romkey);
+    romkey = CRC32((const u8*)&romlen, sizeof(romlen), romkey);
+
+    // the firmware and the game can both see what's in the GBA slot
+    if (const GBACart::CartCommon* gbacart = nds.GetGBACart())
+    {
+        const u32 gbakey[3] = {gbacart->Type(), gbacart->Checksum(), gbacart->GetROMLength()};
+        romkey = CRC32((const u8*)gbakey, sizeof(gbakey), romkey);
+    }
+
+    const u8 version[2] = {SAVESTATE_MAJOR, SAVESTATE_MINOR};
+    const Firmware& firmware = nds.GetFirmware();
+    u32 syskey = CRC32(version, sizeof(version));
+    syskey = CRC32(nds.GetARM9BIOS().data(), ARM9BIOSSize, syskey);
+    syskey = CRC32(nds.GetARM7BIOS().data(), ARM7BIOSSize, syskey);
+    syskey = CRC32(firmware.Buffer(), firmware.Length(), syskey);
+
+    QDir cache(QStandardPaths::writableLocation(QStandardPaths::CacheLocation));
+    if (!cache.mkpath("boot")) return "";
+
+    QString name = QString("boot/%1-%2.mln").arg(romkey, 8, 16, QChar('0')).arg(syskey, 8, 16, QChar('0'));
+    return cache.absoluteFilePath(name).toStdString();
+}
+
+bool RestoreBootSnapshot(NDS& nds)
+{
+    PendingBootSnapshot = "";
+    BootSnapshotState = nullptr;
+    if (!Config::BootSnapshotCache) return false;
+
+    std::string filename = GetBootSnapshotPath(nds);
+    if (filename.empty()) return false;
+
+    FILE* file = fopen(filename.c_str(), "rb");
+    if (file == nullptr)
+    {
+        PendingBootSnapshot = filename;
+        return false;
+    }
+
+    fseek(file, 0, SEEK_END);
+    size_t size = ftell(file);
+    rewind(file);
+
+    std::vector<u8> buffer(size);
+    bool ok = fread(buffer.data(), size, 1, file) == 1;
+    fclose(file);
+
+    // the snapshot holds the save memory from when it was taken, so keep the current one
+    u32 savelen = nds.GetNDSSaveLength();
+    std::unique_ptr<u8[]> savedata = CopyToUnique(nds.GetNDSSave(), savelen);
+    u32 gbasavelen = nds.GetGBASaveLength();
+    std::unique_ptr<u8[]> gbasavedata = CopyToUnique(nds.GetGBASave(), gbasavelen);
+
+    Savestate state(buffer.data(), size, false);
+    if (!ok || !nds.DoSavestate(&state) || state.Error)
+    {
+        Platform::Log(Platform::LogLevel::Error, "Failed to load boot snapshot \"%s\", booting normally\n", filename.c_str());
+        nds.Reset();
+        nds.SetNDSSave(savedata.get(), savelen);
+        if (gbasavedata) nds.SetGBASave(gbasavedata.get(), gbasavelen);
+        PendingBootSnapshot = filename;
+        return false;
+    }
+
+    nds.SetNDSSave(savedata.get(), savelen);
+    if (gbasavedata) nds.SetGBASave(gbasavedata.get(), gbasavelen);
+    SetBatteryLevels(nds);
+    SetDateTime(nds);
+    return true;
+}
+
+void UpdateBootSnapshot(NDS& nds)
+{
+    if (PendingBootSnapshot.empty())
+    {
+        BootSnapshotState = nullptr;
+        return;
+    }
+
+    // if the player interacts with the firmware, the boot isn't reproducible anymore
+    if (nds.KeyInput != 0x007F03FF || !nds.GetNDSCart())
+    {
+        PendingBootSnapshot = "";
+        BootSnapshotState = nullptr;
+        return;
+    }
+
+    // savestates can only be taken between frames, so the snapshot is the state
+    // from the end of the last frame before the ARM9 jumped to the game's entry point
+    if (nds.IsRunningGame())
+    {
+        if (BootSnapshotState)
+        {
+            FILE* file = fopen(PendingBootSnapshot.c_str(), "wb");
+            if (!file || fwrite(BootSnapshotState->Buffer(), BootSnapshotState->Length(), 1, file) != 1)
+                Platform::Log(Platform::LogLevel::Error, "Failed to write boot snapshot \"%s\"\n", PendingBootSnapshot.c_str());
+
+            if (file) fclose(file);
+        }
+
+        PendingBootSnapshot = "";
+        BootSnapshotState = nullptr;
+        return;
+    }
+
+    if (BootSnapshotState)
+        BootSnapshotState->Rewind(true);
+    else
+        BootSnapshotState = std::make_unique<Savestate>();
+
+    nds.DoSavestate(BootSnapshotState.get());
+    if (BootSnapshotState->Error)
+    {
+        PendingBootSnapshot = "";
+        BootSnapshotState = nullptr;
+    }
+}
+
 void Reset(EmuThread* thread)
 {
+    PendingBootSnapshot = "";
     thread->UpdateConsole(Keep {}, Keep {});
 
     if (Config::ConsoleType == 1) EjectGBACart(*thread->NDS);
@@ -905,6 +1052,10 @@ void Reset(EmuThread* thread)
         {
             thread->NDS->SetupDirectBoot(BaseROMName);
         }
+        else
+        {
+            RestoreBootSnapshot(*thread->NDS);
+        }
     }
 }
 
@@ -920,6 +1071,7 @@ bool BootToMenu(EmuThread* thread)
     if (thread->NDS->NeedsDirectBoot())
         return false;
 
+    PendingBootSnapshot = "";
     InitFirmwareSaveManager(thread);
     thread->NDS->Reset();
     SetBatteryLevels(*thread->NDS);
@@ -1276,9 +1428,74 @@ bool LoadROMData(const QStringList& filepath, std::unique_ptr<u8[]>& filedata, u
         return false;
 }
 
+// Maps a file into memory, read-only.
+// The mapping is released once the last reference to the returned data goes away.
+std::shared_ptr<const u8[]> MapROMFile(const QString& path, u32& filelen) noexcept
+{
+    QFile* file = new QFile(path);
+    qint64 len = file->open(QIODevice::ReadOnly) ? file->size() : 0;
+    uchar* data = (len > 0 && len <= 0x40000000) ? file->map(0, len) : nullptr;
+    if (!data)
+    {
+        delete file;
+        return nullptr;
+    }
+
+    filelen = (u32)len;
+    return std::shared_ptr<const u8[]>(data, [file](const u8*) { delete file; });
+}
+
+// Loads NDS ROM data without parsing it.
+// Plain ROM files are memory-mapped rather than read where possible, so that their contents
+// are only paged in as the game accesses them, and so that instances running
+// the same ROM share the same pages. ROMs inside archives are extracted to an
+// on-disk cache first and mapped from there. Compressed ROMs are read as usual.
+bool LoadROMData(const QStringList& filepath, std::shared_ptr<const u8[]>& filedata, u32& filelen, string& basepath, string& romname) noexcept
+{
+    if (int num = filepath.count(); num == 1)
+    {
+        std::string filename = filepath.at(0).toStdString();
+        if (!(filename.length() > 4 && filename.substr(filename.length() - 4) == ".zst"))
+        {
+            // fall back to reading the file if it can't be mapped
+            if ((filedata = MapROMFile(filepath.at(0), filelen)))
+            {
+                int pos = LastSep(filename);
+                if(pos != -1)
+                    basepath = filename.substr(0, pos);
+
+                romname = filename.substr(pos+1);
+                return true;
+            }
+        }
+    }
+#ifdef ARCHIVE_SUPPORT_ENABLED
+    else if (num == 2 && Config::ArchiveCacheSize > 0)
+    {
+        QString cachedfile = Archive::ExtractFileToCache(filepath.at(0), filepath.at(1), (qint64)Config::ArchiveCacheSize << 20);
+        if (!cachedfile.isEmpty() && (filedata = MapROMFile(cachedfile, filelen)))
+        {
+            std::string std_archivepath = filepath.at(0).toStdString();
+            basepath = std_archivepath.substr(0, LastSep(std_archivepath));
+
+            std::string std_romname = filepath.at(1).toStdString();
+            romname = std_romname.substr(LastSep(std_romname)+1);
+            return true;
+        }
+    }
+#endif
+
+    unique_ptr<u8[]> data = nullptr;
+    if (!LoadROMData(filepath, data, filelen, basepath, romname))
+        return false;
+
+    filedata = std::move(data);
+    return true;
+}
+
 bool LoadROM(EmuThread* emuthread, QStringList filepath, bool reset)
 {
-    unique_ptr<u8[]> filedata = nullptr;
+    std::shared_ptr<const u8[]> filedata = nullptr;
     u32 filelen;
     std::string basepath;
     std::string romname;
@@ -1330,6 +1547,7 @@ bool LoadROM(EmuThread* emuthread, QStringList filepath, bool reset)
         if (!emuthread->UpdateConsole(std::move(cart), Keep {}))
             return false;
 
+        PendingBootSnapshot = "";
         InitFirmwareSaveManager(emuthread);
         emuthread->NDS->Reset();
 
@@ -1337,6 +1555,10 @@ bool LoadROM(EmuThread* emuthread, QStringList filepath, bool reset)
         { // If direct boot is enabled or forced...
             emuthread->NDS->SetupDirectBoot(romname);
         }
+        else
+        {
+            RestoreBootSnapshot(*emuthread->NDS);
+        }
 
         SetBatteryLevels(*emuthread->NDS);
         SetDateTime(*emuthread->NDS);
@@ -51,6 +51,14 @@ void Reset(EmuThread* thread);
 
 /// Boots the emulated console into its system menu without starting a game.
 bool BootToMenu(EmuThread* thread);
+
+// Restores the state the console was in after the firmware last booted the
+// inserted game, if Config::BootSnapshotCache is set and such a snapshot exists.
+// Otherwise, one will be taken by UpdateBootSnapshot once the game is booted.
+bool RestoreBootSnapshot(NDS& nds);
+// Called after every frame; once the ARM9 jumps to the game's entry point,
+// stores the state from the end of the frame before as the pending boot snapshot.
+void UpdateBootSnapshot(NDS& nds);
 void ClearBackupState();
 
 /// Returns the configured ARM9 BIOS loaded from disk,
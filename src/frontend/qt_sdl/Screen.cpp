@@ -621,17 +621,13 @@ void ScreenPanelNative::paintEvent(QPaintEvent* event)
     if (emuThread->emuIsActive())
     {
         assert(emuThread->NDS != nullptr);
-        emuThread->FrontBufferLock.lock();
-        int frontbuf = emuThread->FrontBuffer;
+        // the acquired buffer stays ours until the next call, no need to lock
+        int frontbuf = emuThread->NDS->GPU.AcquireFrontBuffer();
         if (!emuThread->NDS->GPU.Framebuffer[frontbuf][0] || !emuThread->NDS->GPU.Framebuffer[frontbuf][1])
-        {
-            emuThread->FrontBufferLock.unlock();
             return;
-        }
 
         memcpy(screen[0].scanLine(0), emuThread->NDS->GPU.Framebuffer[frontbuf][0].get(), 256 * 192 * 4);
         memcpy(screen[1].scanLine(0), emuThread->NDS->GPU.Framebuffer[frontbuf][1].get(), 256 * 192 * 4);
-        emuThread->FrontBufferLock.unlock();
 
         QRect screenrc(0, 0, 256, 192);
 
@@ -888,7 +884,7 @@ void ScreenPanelGL::drawScreenGL()
     glUseProgram(screenShaderProgram[2]);
     glUniform2f(screenShaderScreenSizeULoc, w / factor, h / factor);
 
-    int frontbuf = emuThread->FrontBuffer;
+    int frontbuf = emuThread->NDS->GPU.GetPresentBuffer();
     glActiveTexture(GL_TEXTURE0);
 
 #ifdef OGLRENDERER_ENABLED